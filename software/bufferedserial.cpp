@@ -0,0 +1,158 @@
+#include "bufferedserial.hpp"
+
+#include <stdint.h>
+#include <Arduino.h>
+#include "stats.hpp"
+
+#if defined(UDR0)
+#define RX_INDEX_MASK (BUFFERED_UART_RX_BUFFER_SIZE - 1)
+#define TX_INDEX_MASK (BUFFERED_UART_TX_BUFFER_SIZE - 1)
+
+static_assert(BUFFERED_UART_RX_BUFFER_SIZE <= 256 &&
+              (BUFFERED_UART_RX_BUFFER_SIZE & RX_INDEX_MASK) == 0,
+              "BUFFERED_UART_RX_BUFFER_SIZE has to be a power of two, 256 at most");
+static_assert(BUFFERED_UART_TX_BUFFER_SIZE <= 256 &&
+              (BUFFERED_UART_TX_BUFFER_SIZE & TX_INDEX_MASK) == 0,
+              "BUFFERED_UART_TX_BUFFER_SIZE has to be a power of two, 256 at most");
+
+BufferedUart UART;
+
+void BufferedUart::begin(uint32_t baudRate)
+{
+    // In double-speed mode, baud = F_CPU / (8 * (UBRR + 1)). This rounds
+    // to the nearest UBRR, like HardwareSerial does.
+    uint16_t baudRateRegister = (F_CPU / 4 / baudRate - 1) / 2;
+    UCSR0B = 0;
+    UBRR0H = baudRateRegister >> 8;
+    UBRR0L = baudRateRegister;
+    UCSR0A = _BV(U2X0);
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00); // 8N1.
+    // Whatever's left in the buffers was meant for the old baud rate. To
+    // get it all sent before switching, flush first.
+    _rxHead = _rxTail = 0;
+    _txHead = _txTail = 0;
+    _hasWritten = false;
+    UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+}
+
+void BufferedUart::end()
+{
+    flush();
+    UCSR0B = 0;
+    _rxHead = _rxTail = 0;
+}
+
+bool BufferedUart::isBaudRateExact(uint32_t baudRate)
+{
+    return baudRate && F_CPU % (8 * baudRate) == 0 && F_CPU / (8 * baudRate) <= 4096;
+}
+
+int BufferedUart::available()
+{
+    return static_cast<uint8_t>(_rxHead - _rxTail) & RX_INDEX_MASK;
+}
+
+int BufferedUart::peek()
+{
+    if (_rxHead == _rxTail) {
+        return -1;
+    }
+    return _rxBuffer[_rxTail];
+}
+
+int BufferedUart::read()
+{
+    if (_rxHead == _rxTail) {
+        return -1;
+    }
+    uint8_t n = _rxBuffer[_rxTail];
+    _rxTail = (_rxTail + 1) & RX_INDEX_MASK;
+    return n;
+}
+
+int BufferedUart::availableForWrite()
+{
+    return TX_INDEX_MASK - (static_cast<uint8_t>(_txHead - _txTail) & TX_INDEX_MASK);
+}
+
+size_t BufferedUart::write(uint8_t n)
+{
+    _hasWritten = true;
+    // Straight into the data register, if there's nothing ahead of it.
+    if (_txHead == _txTail && (UCSR0A & _BV(UDRE0))) {
+        // Writing a one clears TXC0, so flush can tell when this is out.
+        UCSR0A = _BV(U2X0) | _BV(TXC0);
+        UDR0 = n;
+        return 1;
+    }
+
+    uint8_t next = (_txHead + 1) & TX_INDEX_MASK;
+    while (next == _txTail) {
+        // Full! The interrupt handler'll make room soon enough.
+    }
+    _txBuffer[_txHead] = n;
+    _txHead = next;
+    // The interrupt handler turns this off when it runs out, so this can't
+    // be interrupted halfway through.
+    noInterrupts();
+    UCSR0B |= _BV(UDRIE0);
+    interrupts();
+    return 1;
+}
+
+void BufferedUart::flush()
+{
+    if (!_hasWritten) {
+        return;
+    }
+    while ((UCSR0B & _BV(UDRIE0)) || !(UCSR0A & _BV(TXC0))) {}
+}
+
+// In the same file as the interrupt handlers, so that they get inlined.
+
+void BufferedUart::handleReceiveInterrupt()
+{
+    // A frame or parity error means the byte's garbage - which happens
+    // while the host's switching baud rates, if nothing else. An overrun
+    // means one got lost before this one, but this one's fine.
+    uint8_t status = UCSR0A;
+    uint8_t n = UDR0;
+    uint8_t next = (_rxHead + 1) & RX_INDEX_MASK;
+    if (status & (_BV(FE0) | _BV(UPE0)) || next == _rxTail) {
+        STATS_COUNT(STATS_SERIAL_ERRORS);
+        return;
+    }
+    if (status & _BV(DOR0)) {
+        STATS_COUNT(STATS_SERIAL_ERRORS);
+    }
+    _rxBuffer[_rxHead] = n;
+    _rxHead = next;
+#if STATS_ENABLED
+    uint8_t fill = static_cast<uint8_t>(next - _rxTail) & RX_INDEX_MASK;
+    if (fill > STATS[STATS_SERIAL_RX_BUFFER_PEAK]) {
+        STATS[STATS_SERIAL_RX_BUFFER_PEAK] = fill;
+    }
+#endif
+}
+
+void BufferedUart::handleDataRegisterEmptyInterrupt()
+{
+    uint8_t n = _txBuffer[_txTail];
+    _txTail = (_txTail + 1) & TX_INDEX_MASK;
+    UCSR0A = _BV(U2X0) | _BV(TXC0);
+    UDR0 = n;
+    if (_txHead == _txTail) {
+        UCSR0B &= ~_BV(UDRIE0);
+    }
+}
+
+ISR(USART_RX_vect)
+{
+    UART.handleReceiveInterrupt();
+}
+
+ISR(USART_UDRE_vect)
+{
+    UART.handleDataRegisterEmptyInterrupt();
+}
+#endif
@@ -0,0 +1,69 @@
+#ifndef BUFFEREDSERIAL_HPP
+#define BUFFEREDSERIAL_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// A stand-in for the Arduino core's Serial, for USART0. It's the same idea,
+// but with bigger ring buffers (HardwareSerial's are 64 bytes each), and
+// always in double-speed mode (U2X), where a 16 MHz clock divides evenly
+// into 500k, 1M and 2M baud - so the host can ask for one of those with
+// SET_BAUD_RATE, and have it work without any error at all. 115200, the
+// rate everything starts out at, is 2.1% off either way, same as with
+// HardwareSerial.
+//
+// Using this instead of Serial keeps HardwareSerial's interrupt handlers
+// from being linked in, so don't use both - it won't build.
+
+// These have to be powers of two, 256 at most. Every byte of them is one
+// the stack and the scratch buffer don't get (see scratch.hpp), so don't go
+// overboard!
+#ifndef BUFFERED_UART_RX_BUFFER_SIZE
+#define BUFFERED_UART_RX_BUFFER_SIZE 256
+#endif
+#ifndef BUFFERED_UART_TX_BUFFER_SIZE
+#define BUFFERED_UART_TX_BUFFER_SIZE 128
+#endif
+
+#if defined(UDR0)
+class BufferedUart : public Stream
+{
+public:
+    void begin(uint32_t baudRate);
+    void end();
+    // Whether baudRate divides F_CPU evenly enough to be exact.
+    static bool isBaudRateExact(uint32_t baudRate);
+
+    // available and availableForWrite are how full the buffers are: how
+    // many bytes there are to read, and how many can be written without
+    // waiting.
+    int available() override;
+    int peek() override;
+    int read() override;
+    size_t write(uint8_t n) override;
+    using Print::write;
+    int availableForWrite() override;
+    // Waits until everything's been sent, down to the last bit.
+    void flush() override;
+
+    // Only for the interrupt handlers!
+    void handleReceiveInterrupt();
+    void handleDataRegisterEmptyInterrupt();
+private:
+    // One byte each is all the indices need, so the interrupt handlers and
+    // everything else can share them without turning interrupts off.
+    volatile uint8_t _rxHead = 0;
+    volatile uint8_t _rxTail = 0;
+    volatile uint8_t _txHead = 0;
+    volatile uint8_t _txTail = 0;
+    // Whether anything's been written since begin - flush has nothing to
+    // wait for otherwise, and TXC0 would never get set.
+    bool _hasWritten = false;
+    uint8_t _rxBuffer[BUFFERED_UART_RX_BUFFER_SIZE];
+    uint8_t _txBuffer[BUFFERED_UART_TX_BUFFER_SIZE];
+};
+
+extern BufferedUart UART;
+#endif
+
+#endif
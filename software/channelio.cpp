@@ -60,6 +60,39 @@ InputOutputChannelSet<OutputType, Contained>::InputOutputChannelSet(
     OutputChannelSet<OutputType, Contained>(numChannels, channels),
     _numChannels(numChannels), _channels(channels) {}
 
+template <class OutputType, class First, class Second>
+InputOutputChannelPair<OutputType, First, Second>::InputOutputChannelPair(
+    First* first, Second* second) :
+    _first(first), _second(second) {}
+
+template <class OutputType, class First, class Second>
+OutputType InputOutputChannelPair<OutputType, First, Second>::input()
+{
+    // Same as in InputChannelSet - the channels shouldn't overlap.
+    return _first->input() | _second->input();
+}
+
+template <class OutputType, class First, class Second>
+void InputOutputChannelPair<OutputType, First, Second>::output(OutputType n)
+{
+    _first->output(n);
+    _second->output(n);
+}
+
+template <class OutputType, class First, class Second>
+void InputOutputChannelPair<OutputType, First, Second>::initInput()
+{
+    _first->initInput();
+    _second->initInput();
+}
+
+template <class OutputType, class First, class Second>
+void InputOutputChannelPair<OutputType, First, Second>::initOutput()
+{
+    _first->initOutput();
+    _second->initOutput();
+}
+
 template <class T>
 Output_ShiftRegister<T>::Output_ShiftRegister(
     unsigned int dataPin, unsigned int shiftPin,
@@ -96,11 +129,11 @@ Output_Spi<T>::Output_Spi(uint32_t frequency, uint8_t mode) :
 template <class T>
 void Output_Spi<T>::output(T n)
 {
-    SPI.beginTransaction(_settings);
+    if (!_blockDepth) {SPI.beginTransaction(_settings);}
     for (int byteStart = (sizeof(T) - 1) * 8; byteStart >= 0; byteStart -= 8) {
         SPI.transfer(n >> byteStart);
     }
-    SPI.endTransaction();
+    if (!_blockDepth) {SPI.endTransaction();}
 }
 
 template <class T>
@@ -110,35 +143,258 @@ void Output_Spi<T>::initOutput()
 }
 
 template <class T>
-Output_SpiShiftRegister<T>::Output_SpiShiftRegister(
-    uint32_t frequency, uint8_t spiMode, uint8_t latchPin) :
-    Output_Spi<T>(frequency, spiMode), _latchPin(pinToPortInfo(latchPin)) {}
+void Output_Spi<T>::beginOutput(T n)
+{
+    // SPDR isn't buffered, so only the first byte can be started without
+    // waiting. SPIF is only polled once the rest are actually needed.
+    if (!_blockDepth) {SPI.beginTransaction(_settings);}
+    SPDR = n >> ((sizeof(T) - 1) * 8);
+    _pendingOutput = n;
+}
 
 template <class T>
-void Output_SpiShiftRegister<T>::output(T n)
+void Output_Spi<T>::completeOutput()
 {
-    SET_BITS_IN_PORT_LOW(_latchPin.out, _latchPin.bitMask);
-    Output_Spi<T>::output(n);
-    SET_BITS_IN_PORT_HIGH(_latchPin.out, _latchPin.bitMask);
+    for (int byteStart = (static_cast<int>(sizeof(T)) - 2) * 8;
+         byteStart >= 0; byteStart -= 8) {
+        while (!(SPSR & _BV(SPIF))) {}
+        SPDR = _pendingOutput >> byteStart;
+    }
+    while (!(SPSR & _BV(SPIF))) {}
+    (void) SPDR; // Clears SPIF, now that SPSR has been read with it set.
+    if (!_blockDepth) {SPI.endTransaction();}
 }
 
 template <class T>
-void Output_SpiShiftRegister<T>::initOutput()
+void Output_Spi<T>::beginBlock()
+{
+    if (!_blockDepth++) {SPI.beginTransaction(_settings);}
+}
+
+template <class T>
+void Output_Spi<T>::endBlock()
+{
+    if (!--_blockDepth) {SPI.endTransaction();}
+}
+
+template <class T, class LatchPinType>
+Output_SpiShiftRegister<T, LatchPinType>::Output_SpiShiftRegister(
+    uint32_t frequency, uint8_t spiMode, LatchPinType latchPin) :
+    Output_Spi<T>(frequency, spiMode), _latchPin(latchPin) {}
+
+template <class T, class LatchPinType>
+void Output_SpiShiftRegister<T, LatchPinType>::output(T n)
+{
+    _latchPin.setLow();
+    Output_Spi<T>::output(n);
+    _latchPin.setHigh();
+}
+
+template <class T, class LatchPinType>
+void Output_SpiShiftRegister<T, LatchPinType>::beginOutput(T n)
+{
+    _latchPin.setLow();
+    Output_Spi<T>::beginOutput(n);
+}
+
+template <class T, class LatchPinType>
+void Output_SpiShiftRegister<T, LatchPinType>::completeOutput()
+{
+    Output_Spi<T>::completeOutput();
+    _latchPin.setHigh();
+}
+
+template <class T, class LatchPinType>
+void Output_SpiShiftRegister<T, LatchPinType>::initOutput()
 {
     Output_Spi<T>::initOutput();
-    pinMode(_latchPin.pin, OUTPUT);
-    SET_BITS_IN_PORT_HIGH(_latchPin.out, _latchPin.bitMask);
+    _latchPin.setOutput();
+    _latchPin.setHigh();
+}
+
+template <uint8_t... pins>
+InputOutput_PinBus<pins...>::InputOutput_PinBus(uint8_t inputMode) :
+    _inputMode(inputMode) {}
+
+template <uint8_t... pins>
+uint8_t InputOutput_PinBus<pins...>::input()
+{
+    // Ports without any of the pins on them compile to nothing.
+    return _input<StaticPort::B>() |
+           _input<StaticPort::C>() |
+           _input<StaticPort::D>();
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+uint8_t InputOutput_PinBus<pins...>::_input()
+{
+    if (!Port<port>::mask) {return 0;}
+    uint8_t portValue = StaticPortRegisters<port>::in() & Port<port>::mask;
+    return _gather<port>(portValue, Shiftable<Port<port>::isShiftable>());
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+uint8_t InputOutput_PinBus<pins...>::_gather(uint8_t portValue,
+                                             Shiftable<true>)
+{
+    return staticPinsShift(portValue, -Port<port>::offset);
 }
 
+template <uint8_t... pins>
+template <StaticPort port>
+uint8_t InputOutput_PinBus<pins...>::_gather(uint8_t portValue,
+                                             Shiftable<false>)
+{
+    return pgm_read_byte(&Port<port>::Tables::gather[portValue]);
+}
+
+template <uint8_t... pins>
+void InputOutput_PinBus<pins...>::output(uint8_t n)
+{
+    _output<StaticPort::B>(n);
+    _output<StaticPort::C>(n);
+    _output<StaticPort::D>(n);
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+void InputOutput_PinBus<pins...>::_output(uint8_t n)
+{
+    if (!Port<port>::mask) {return;}
+    uint8_t portBits = _scatter<port>(n, Shiftable<Port<port>::isShiftable>());
+    PortRegister& out = StaticPortRegisters<port>::out();
+    out = (out & static_cast<uint8_t>(~Port<port>::mask)) | portBits;
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+uint8_t InputOutput_PinBus<pins...>::_scatter(uint8_t n, Shiftable<true>)
+{
+    return staticPinsShift(n, Port<port>::offset) & Port<port>::mask;
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+uint8_t InputOutput_PinBus<pins...>::_scatter(uint8_t n, Shiftable<false>)
+{
+    return pgm_read_byte(&Port<port>::Tables::scatter[n]);
+}
+
+template <uint8_t... pins>
+void InputOutput_PinBus<pins...>::initInput()
+{
+    bool pullUp = _inputMode == INPUT_PULLUP;
+    _initInput<StaticPort::B>(pullUp);
+    _initInput<StaticPort::C>(pullUp);
+    _initInput<StaticPort::D>(pullUp);
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+void InputOutput_PinBus<pins...>::_initInput(bool pullUp)
+{
+    if (!Port<port>::mask) {return;}
+    StaticPortRegisters<port>::direction() &=
+        static_cast<uint8_t>(~Port<port>::mask);
+    if (pullUp) {
+        StaticPortRegisters<port>::out() |= Port<port>::mask;
+    } else {
+        StaticPortRegisters<port>::out() &=
+            static_cast<uint8_t>(~Port<port>::mask);
+    }
+}
+
+template <uint8_t... pins>
+void InputOutput_PinBus<pins...>::initOutput()
+{
+    _initOutput<StaticPort::B>();
+    _initOutput<StaticPort::C>();
+    _initOutput<StaticPort::D>();
+}
+
+template <uint8_t... pins>
+template <StaticPort port>
+void InputOutput_PinBus<pins...>::_initOutput()
+{
+    if (!Port<port>::mask) {return;}
+    StaticPortRegisters<port>::direction() |= Port<port>::mask;
+}
+
+#if defined(UDR0) || defined(UDR1)
+template <class T, class UsartType, class LatchPinType>
+Output_UsartSpiShiftRegister<T, UsartType, LatchPinType>::Output_UsartSpiShiftRegister(
+    uint32_t frequency, uint8_t spiMode, LatchPinType latchPin) :
+    _latchPin(latchPin)
+{
+    // f_XCK = F_CPU / (2 * (UBRR + 1)), so F_CPU / 2 at most. Rounds so
+    // that the actual frequency is never higher than the one requested.
+    uint32_t divisor = (F_CPU / 2 + frequency - 1) / frequency;
+    _baudRateRegister = divisor > 1 ? divisor - 1 : 0;
+
+    // UMSEL0n = 0b11 is master SPI mode. UCPOL0 is bit 0 and UCPHA0 is
+    // bit 1 in that mode; the SPI_MODEn constants use SPCR's CPOL and CPHA.
+    _controlC = _BV(UMSEL01) | _BV(UMSEL00);
+    if (spiMode & _BV(CPOL)) {_controlC |= _BV(0);}
+    if (spiMode & _BV(CPHA)) {_controlC |= _BV(1);}
+}
+
+template <class T, class UsartType, class LatchPinType>
+void Output_UsartSpiShiftRegister<T, UsartType, LatchPinType>::output(T n)
+{
+    beginOutput(n);
+    completeOutput();
+}
+
+template <class T, class UsartType, class LatchPinType>
+void Output_UsartSpiShiftRegister<T, UsartType, LatchPinType>::beginOutput(T n)
+{
+    _latchPin.setLow();
+    // Writing a one to TXC clears it, so it can tell us when the last
+    // byte has been shifted all the way out.
+    UsartType::controlA() = _BV(TXC0);
+    // With the shift register and the transmit buffer both empty, the first
+    // two bytes are queued without any waiting - for a 16-bit address, that
+    // means this returns immediately.
+    for (int byteStart = (sizeof(T) - 1) * 8; byteStart >= 0; byteStart -= 8) {
+        while (!(UsartType::controlA() & _BV(UDRE0))) {}
+        UsartType::data() = n >> byteStart;
+    }
+}
+
+template <class T, class UsartType, class LatchPinType>
+void Output_UsartSpiShiftRegister<T, UsartType, LatchPinType>::completeOutput()
+{
+    while (!(UsartType::controlA() & _BV(TXC0))) {}
+    _latchPin.setHigh();
+}
+
+template <class T, class UsartType, class LatchPinType>
+void Output_UsartSpiShiftRegister<T, UsartType, LatchPinType>::initOutput()
+{
+    // The datasheet's MSPIM init order: UBRR has to be zero while enabling
+    // the transmitter, and XCK has to be an output for master mode.
+    UsartType::baudRate() = 0;
+    UsartType::initXckPin();
+    UsartType::controlC() = _controlC;
+    UsartType::controlB() = _BV(TXEN0);
+    UsartType::baudRate() = _baudRateRegister;
+
+    _latchPin.setOutput();
+    _latchPin.setHigh();
+}
+#endif
+
 #else
 // Non-template implementations.
 #include "channelio.hpp"
 
 InputOutput_Port::InputOutput_Port(
     uint8_t inputMode,
-    volatile uint8_t* inputRegister,
-    volatile uint8_t* outputRegister,
-    volatile uint8_t* directionRegister,
+    PortRegister* inputRegister,
+    PortRegister* outputRegister,
+    PortRegister* directionRegister,
     unsigned int portStartBit,
     unsigned int valueStartBit,
     unsigned int numBits) :
@@ -5,12 +5,22 @@
 #include <SPI.h>
 #include "fastpins.hpp"
 
+// For address channels wider than 16 bits, like a chain of three 74HC595s.
+// avr-gcc has a native 24-bit integer type, which means one less byte to
+// shift out per address than uint32_t. Elsewhere, uint32_t stands in for it.
+#ifdef __AVR__
+typedef __uint24 uint24_t;
+#else
+typedef uint32_t uint24_t;
+#endif
+
 // Base classes
 
 template <class T>
 class InputChannel
 {
 public:
+    typedef T ValueType;
     virtual ~InputChannel() {}
     virtual T input() = 0;
     virtual void initInput() = 0;
@@ -20,9 +30,20 @@ template <class T>
 class OutputChannel
 {
 public:
+    typedef T ValueType;
     virtual ~OutputChannel() {}
     virtual void output(T n) = 0;
     virtual void initOutput() = 0;
+    // Split-phase output: beginOutput starts outputting n, and
+    // completeOutput waits until it's actually been output. Whatever's done
+    // in between overlaps with the output. Channels that can't do it that
+    // way just output everything right away in beginOutput.
+    virtual void beginOutput(T n) {output(n);}
+    virtual void completeOutput() {}
+    // Brackets a block of outputs, letting the channel skip per-output setup
+    // (such as an SPI transaction) in between. Blocks may be nested.
+    virtual void beginBlock() {}
+    virtual void endBlock() {}
 };
 
 template <class T>
@@ -30,6 +51,7 @@ class InputOutputChannel : virtual public InputChannel<T>,
                            virtual public OutputChannel<T>
 {
 public:
+    typedef T ValueType;
     virtual ~InputOutputChannel() {}
 };
 
@@ -75,10 +97,27 @@ private:
     Contained** _channels;
 };
 
+// The same idea as a channel set, but with the contained channels' types
+// known at compile time. If those are final, nothing here is virtual - the
+// calls get inlined straight into whatever uses the pair.
+template <class OutputType, class First, class Second>
+class InputOutputChannelPair final : public InputOutputChannel<OutputType>
+{
+public:
+    InputOutputChannelPair(First* first, Second* second);
+    OutputType input();
+    void output(OutputType n);
+    void initInput();
+    void initOutput();
+private:
+    First* _first;
+    Second* _second;
+};
+
 // Specific IO types
 
 template <class T>
-class Output_ShiftRegister : public OutputChannel<T>
+class Output_ShiftRegister final : public OutputChannel<T>
 {
 public:
     Output_ShiftRegister(unsigned int dataPin, unsigned int shiftPin,
@@ -99,28 +138,145 @@ public:
     Output_Spi(uint32_t frequency, uint8_t mode);
     virtual void output(T n);
     virtual void initOutput();
+    virtual void beginOutput(T n);
+    virtual void completeOutput();
+    virtual void beginBlock();
+    virtual void endBlock();
 private:
     SPISettings _settings;
+    T _pendingOutput;
+    uint8_t _blockDepth = 0;
 };
 
-template <class T>
-class Output_SpiShiftRegister : public Output_Spi<T>
+// LatchPinType is RuntimePin or a StaticPin (see fastpins.hpp).
+template <class T, class LatchPinType = RuntimePin>
+class Output_SpiShiftRegister final : public Output_Spi<T>
 {
 public:
-    Output_SpiShiftRegister(uint32_t frequency, uint8_t spiMode, uint8_t latchPin);
+    Output_SpiShiftRegister(uint32_t frequency, uint8_t spiMode,
+                            LatchPinType latchPin);
     void output(T n);
     void initOutput();
+    void beginOutput(T n);
+    void completeOutput();
 private:
-    PinPortInfo _latchPin;
+    LatchPinType _latchPin;
+};
+
+#if defined(UDR0) || defined(UDR1)
+// Register sets for Output_UsartSpiShiftRegister. The bit positions within
+// the registers are the same for every USART, so the USART0 names are used.
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || \
+    defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__) || \
+    defined(__AVR_ATmega328PB__)
+struct Usart0
+{
+    static inline volatile uint8_t& controlA() {return UCSR0A;}
+    static inline volatile uint8_t& controlB() {return UCSR0B;}
+    static inline volatile uint8_t& controlC() {return UCSR0C;}
+    static inline volatile uint16_t& baudRate() {return UBRR0;}
+    static inline volatile uint8_t& data() {return UDR0;}
+    static inline void initXckPin() {DDRD |= _BV(4);} // XCK0 is PD4.
+};
+#endif
+#if defined(__AVR_ATmega328PB__)
+struct Usart1
+{
+    static inline volatile uint8_t& controlA() {return UCSR1A;}
+    static inline volatile uint8_t& controlB() {return UCSR1B;}
+    static inline volatile uint8_t& controlC() {return UCSR1C;}
+    static inline volatile uint16_t& baudRate() {return UBRR1;}
+    static inline volatile uint8_t& data() {return UDR1;}
+    static inline void initXckPin() {DDRB |= _BV(5);} // XCK1 is PB5 (SCK).
+};
+#endif
+
+// Drives a shift register chain with a USART in master SPI mode (MSPIM)
+// instead of the SPI peripheral. The USART's transmitter is double-buffered,
+// so all of T's bytes go out back to back without any gap to reload SPDR in,
+// and there's no SPI.beginTransaction/endTransaction to pay for either.
+// See the hardware README for which layouts have their shift registers
+// hooked up to a USART's TXD and XCK pins - the stock ones don't!
+template <class T, class UsartType, class LatchPinType = RuntimePin>
+class Output_UsartSpiShiftRegister final : public OutputChannel<T>
+{
+public:
+    Output_UsartSpiShiftRegister(uint32_t frequency, uint8_t spiMode,
+                                 LatchPinType latchPin);
+    void output(T n);
+    void initOutput();
+    void beginOutput(T n);
+    void completeOutput();
+private:
+    uint16_t _baudRateRegister;
+    uint8_t _controlC;
+    LatchPinType _latchPin;
+};
+#endif
+
+// A data bus wired to any set of pins, known at compile time: bit 0 of the
+// value is on the first pin listed, bit 1 on the second, and so on. For each
+// port the pins are on, input/output is just one register access - plus a
+// shift where the pins are offset from their bits by the same amount, or a
+// 256-byte PROGMEM table lookup where the wiring's more scrambled than that.
+// Either way, it's all worked out at compile time. This lets a layout route
+// its data bus however it likes without paying for it on every byte.
+template <uint8_t... pins>
+class InputOutput_PinBus final : public InputOutputChannel<uint8_t>
+{
+    static_assert(STATIC_PINS_SUPPORTED,
+                  "InputOutput_PinBus doesn't know this MCU's pinout.");
+    static_assert(sizeof...(pins) >= 1 && sizeof...(pins) <= 8,
+                  "InputOutput_PinBus takes between 1 and 8 pins.");
+    static_assert(
+        staticPinsPopCount(staticPinsPortMask(StaticPort::B, pins...)) +
+        staticPinsPopCount(staticPinsPortMask(StaticPort::C, pins...)) +
+        staticPinsPopCount(staticPinsPortMask(StaticPort::D, pins...)) ==
+        sizeof...(pins),
+        "InputOutput_PinBus given the same pin more than once."
+    );
+public:
+    InputOutput_PinBus(uint8_t inputMode);
+    uint8_t input();
+    void output(uint8_t n);
+    void initInput();
+    void initOutput();
+private:
+    template <bool> struct Shiftable {};
+    template <StaticPort port> struct Port
+    {
+        static const uint8_t mask = staticPinsPortMask(port, pins...);
+        static const int offset = staticPinsPortOffset(port, 0, pins...);
+        static const bool isShiftable =
+            staticPinsPortIsShiftable(port, offset, 0, pins...);
+        typedef StaticPinsTables<
+            port, typename StaticPinsMakeIndices<256>::Type, pins...
+        > Tables;
+    };
+
+    template <StaticPort port> static inline uint8_t _input();
+    template <StaticPort port>
+    static inline uint8_t _gather(uint8_t portValue, Shiftable<true>);
+    template <StaticPort port>
+    static inline uint8_t _gather(uint8_t portValue, Shiftable<false>);
+    template <StaticPort port> static inline void _output(uint8_t n);
+    template <StaticPort port>
+    static inline uint8_t _scatter(uint8_t n, Shiftable<true>);
+    template <StaticPort port>
+    static inline uint8_t _scatter(uint8_t n, Shiftable<false>);
+    template <StaticPort port> static inline void _initInput(bool pullUp);
+    template <StaticPort port> static inline void _initOutput();
+
+    uint8_t _inputMode;
 };
 
-class InputOutput_Port : public InputOutputChannel<uint8_t>
+class InputOutput_Port final : public InputOutputChannel<uint8_t>
 {
 public:
     InputOutput_Port(uint8_t inputMode,
-                     volatile uint8_t* inputRegister,
-                     volatile uint8_t* outputRegister,
-                     volatile uint8_t* directionRegister,
+                     PortRegister* inputRegister,
+                     PortRegister* outputRegister,
+                     PortRegister* directionRegister,
                      unsigned int portStartBit,
                      unsigned int valueStartBit,
                      unsigned int numBits);
@@ -130,9 +286,9 @@ public:
     void initOutput();
 private:
     uint8_t _inputMode;
-    volatile uint8_t* _inputRegister;
-    volatile uint8_t* _outputRegister;
-    volatile uint8_t* _directionRegister;
+    PortRegister* _inputRegister;
+    PortRegister* _outputRegister;
+    PortRegister* _directionRegister;
     unsigned int _portStartBit;
     unsigned int _valueStartBit;
     unsigned int _numBits;
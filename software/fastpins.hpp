@@ -4,12 +4,20 @@
 #include <stdint.h>
 #include <Arduino.h>
 
+// An 8-bit IO register. The host build (see host/) swaps in a simulated one
+// so that it can watch what the firmware does to the ports.
+#ifdef FASTPINS_REGISTER_TYPE
+typedef FASTPINS_REGISTER_TYPE PortRegister;
+#else
+typedef volatile uint8_t PortRegister;
+#endif
+
 struct PinPortInfo
 {
     uint8_t pin;
-    volatile uint8_t* in;
-    volatile uint8_t* out;
-    volatile uint8_t* direction;
+    PortRegister* in;
+    PortRegister* out;
+    PortRegister* direction;
     uint8_t bitNum;
     uint8_t bitMask;
 };
@@ -23,4 +31,187 @@ PinPortInfo pinToPortInfo(uint8_t pin);
 #define SET_BITS_IN_PORT_HIGH(outputReg, bitMask) (*(outputReg) |= (bitMask))
 #define SET_BITS_IN_PORT_LOW(outputReg, bitMask) (*(outputReg) &= ~(bitMask))
 
+// Pins resolved at runtime. Same interface as StaticPin below, so that code
+// templated on its pin type can take either. Implicitly constructible from
+// a pin number, so anything that used to take a pin number still does.
+class RuntimePin
+{
+public:
+    RuntimePin(uint8_t pin) : _info(pinToPortInfo(pin)) {}
+    inline uint8_t number() {return _info.pin;}
+    inline void setHigh() {SET_BITS_IN_PORT_HIGH(_info.out, _info.bitMask);}
+    inline void setLow() {SET_BITS_IN_PORT_LOW(_info.out, _info.bitMask);}
+    inline uint8_t read() {return READ_BIT_IN_PORT(_info.in, _info.bitNum);}
+    inline void setOutput() {pinMode(_info.pin, OUTPUT);}
+    inline void setInput() {pinMode(_info.pin, INPUT);}
+private:
+    PinPortInfo _info;
+};
+
+// Pins resolved at compile time. Since both the register and the bit are
+// constants, setHigh/setLow compile to a single sbi/cbi, and read to a
+// single sbis/sbic - as opposed to a pointer load and a read-modify-write.
+// Only the standard ATmega328P/168 pinout (Uno, Nano, Pro Mini, etc.) is
+// mapped here, since the Arduino core's mapping lives in PROGMEM tables that
+// can't be read at compile time. For other MCUs, use RuntimePin.
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || \
+    defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__)
+#define STATIC_PINS_SUPPORTED 1
+#else
+#define STATIC_PINS_SUPPORTED 0
+#endif
+#define STATIC_PINS_NUM_PINS 20
+
+enum class StaticPort : uint8_t {B, C, D};
+
+constexpr StaticPort staticPinPort(uint8_t pin)
+{
+    return pin < 8 ? StaticPort::D : pin < 14 ? StaticPort::B : StaticPort::C;
+}
+
+constexpr uint8_t staticPinBitNum(uint8_t pin)
+{
+    return pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14;
+}
+
+template <StaticPort port>
+struct StaticPortRegisters
+{
+    static inline PortRegister& in()
+    {
+        return port == StaticPort::B ? PINB :
+               port == StaticPort::C ? PINC : PIND;
+    }
+    static inline PortRegister& out()
+    {
+        return port == StaticPort::B ? PORTB :
+               port == StaticPort::C ? PORTC : PORTD;
+    }
+    static inline PortRegister& direction()
+    {
+        return port == StaticPort::B ? DDRB :
+               port == StaticPort::C ? DDRC : DDRD;
+    }
+};
+
+template <uint8_t pin>
+class StaticPin
+{
+    static_assert(STATIC_PINS_SUPPORTED,
+                  "StaticPin doesn't know this MCU's pinout. Use RuntimePin.");
+    static_assert(pin < STATIC_PINS_NUM_PINS,
+                  "StaticPin given a pin that doesn't exist on this board.");
+public:
+    static const StaticPort port = staticPinPort(pin);
+    static const uint8_t bitNum = staticPinBitNum(pin);
+    static const uint8_t bitMask = 1 << bitNum;
+
+    static inline PortRegister& in() {return StaticPortRegisters<port>::in();}
+    static inline PortRegister& out() {return StaticPortRegisters<port>::out();}
+    static inline PortRegister& direction()
+    {
+        return StaticPortRegisters<port>::direction();
+    }
+
+    static inline uint8_t number() {return pin;}
+    static inline void setHigh() {out() |= bitMask;}
+    static inline void setLow() {out() &= static_cast<uint8_t>(~bitMask);}
+    static inline uint8_t read() {return (in() >> bitNum) & 1;}
+    static inline void setOutput() {direction() |= bitMask;}
+    static inline void setInput() {direction() &= static_cast<uint8_t>(~bitMask);}
+};
+
+// Compile-time pin groups: the building blocks for mapping the bits of a
+// value onto a list of pins (bit 0 on the first pin, and so on) and back.
+// These are all C++11 constexpr, hence the recursion.
+
+// The bits of the given port that the pins are on.
+constexpr uint8_t staticPinsPortMask(StaticPort) {return 0;}
+template <class... Rest>
+constexpr uint8_t staticPinsPortMask(StaticPort port, uint8_t pin, Rest... rest)
+{
+    return (staticPinPort(pin) == port ? 1 << staticPinBitNum(pin) : 0) |
+           staticPinsPortMask(port, rest...);
+}
+
+constexpr uint8_t staticPinsPopCount(uint8_t n)
+{
+    return n ? (n & 1) + staticPinsPopCount(n >> 1) : 0;
+}
+
+// Whether every pin on the given port is offset the same number of bits
+// from its value bit. If so, moving bits between that port and the value is
+// a single mask and shift; if not, it takes a lookup table.
+constexpr int STATIC_PINS_NO_OFFSET = 0x7FFF;
+constexpr int staticPinsPortOffset(StaticPort, int) {return STATIC_PINS_NO_OFFSET;}
+template <class... Rest>
+constexpr int staticPinsPortOffset(StaticPort port, int valueBit,
+                                   uint8_t pin, Rest... rest)
+{
+    return staticPinPort(pin) == port ?
+        staticPinBitNum(pin) - valueBit :
+        staticPinsPortOffset(port, valueBit + 1, rest...);
+}
+
+constexpr bool staticPinsPortIsShiftable(StaticPort, int, int) {return true;}
+template <class... Rest>
+constexpr bool staticPinsPortIsShiftable(StaticPort port, int offset,
+                                         int valueBit, uint8_t pin,
+                                         Rest... rest)
+{
+    return (staticPinPort(pin) != port ||
+            staticPinBitNum(pin) - valueBit == offset) &&
+           staticPinsPortIsShiftable(port, offset, valueBit + 1, rest...);
+}
+
+constexpr uint8_t staticPinsShift(uint8_t n, int offset)
+{
+    return offset >= 0 ? n << offset : n >> -offset;
+}
+
+// The bits of the given port's input register, gathered into a value...
+constexpr uint8_t staticPinsGather(StaticPort, uint8_t, int) {return 0;}
+template <class... Rest>
+constexpr uint8_t staticPinsGather(StaticPort port, uint8_t portValue,
+                                   int valueBit, uint8_t pin, Rest... rest)
+{
+    return (staticPinPort(pin) == port ?
+                ((portValue >> staticPinBitNum(pin)) & 1) << valueBit : 0) |
+           staticPinsGather(port, portValue, valueBit + 1, rest...);
+}
+
+// ...and the bits of a value, scattered into the given port's bits.
+constexpr uint8_t staticPinsScatter(StaticPort, uint8_t, int) {return 0;}
+template <class... Rest>
+constexpr uint8_t staticPinsScatter(StaticPort port, uint8_t value,
+                                    int valueBit, uint8_t pin, Rest... rest)
+{
+    return (staticPinPort(pin) == port ?
+                ((value >> valueBit) & 1) << staticPinBitNum(pin) : 0) |
+           staticPinsScatter(port, value, valueBit + 1, rest...);
+}
+
+// The lookup tables, generated at compile time and stored in PROGMEM.
+// They only end up in the binary if they're actually used.
+template <unsigned int... i> struct StaticPinsIndices {};
+template <unsigned int n, unsigned int... i>
+struct StaticPinsMakeIndices : StaticPinsMakeIndices<n - 1, n - 1, i...> {};
+template <unsigned int... i>
+struct StaticPinsMakeIndices<0, i...> {typedef StaticPinsIndices<i...> Type;};
+
+template <StaticPort port, class Indices, uint8_t... pins>
+struct StaticPinsTables;
+template <StaticPort port, unsigned int... i, uint8_t... pins>
+struct StaticPinsTables<port, StaticPinsIndices<i...>, pins...>
+{
+    static const uint8_t gather[256];
+    static const uint8_t scatter[256];
+};
+template <StaticPort port, unsigned int... i, uint8_t... pins>
+const uint8_t StaticPinsTables<port, StaticPinsIndices<i...>, pins...>::
+    gather[256] PROGMEM = {staticPinsGather(port, i, 0, pins...)...};
+template <StaticPort port, unsigned int... i, uint8_t... pins>
+const uint8_t StaticPinsTables<port, StaticPinsIndices<i...>, pins...>::
+    scatter[256] PROGMEM = {staticPinsScatter(port, i, 0, pins...)...};
+
 #endif
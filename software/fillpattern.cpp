@@ -0,0 +1,57 @@
+#include "fillpattern.hpp"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FILL_LFSR_TAPS 0x80200003UL
+
+bool initFillPattern(uint8_t id, uint32_t seed, uint32_t address, FillPattern* pattern)
+{
+    pattern->id = id;
+    switch (id) {
+    case FILL_CONSTANT:
+    case FILL_INCREMENTING:
+        pattern->state = seed;
+        return true;
+    case FILL_ADDRESS:
+        pattern->state = address;
+        return true;
+    case FILL_LFSR:
+        pattern->state = seed ? seed : 1;
+        return true;
+    }
+    return false;
+}
+
+void fillPatternBytes(FillPattern* pattern, uint8_t* dest, size_t length)
+{
+    // The switch goes outside the loops, so each byte's just a few
+    // instructions - this is meant to keep up with the chip, after all.
+    uint32_t state = pattern->state;
+    uint8_t* end = dest + length;
+    switch (pattern->id) {
+    case FILL_CONSTANT:
+        while (dest < end) {
+            *dest++ = state;
+        }
+        break;
+    case FILL_INCREMENTING:
+        while (dest < end) {
+            *dest++ = state++;
+        }
+        break;
+    case FILL_ADDRESS:
+        while (dest < end) {
+            *dest++ = state ^ state >> 8 ^ state >> 16 ^ state >> 24;
+            state++;
+        }
+        break;
+    case FILL_LFSR:
+        while (dest < end) {
+            state = state & 1 ? state >> 1 ^ FILL_LFSR_TAPS : state >> 1;
+            *dest++ = state;
+        }
+        break;
+    }
+    pattern->state = state;
+}
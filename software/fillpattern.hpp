@@ -0,0 +1,42 @@
+#ifndef FILLPATTERN_HPP
+#define FILLPATTERN_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Patterns for filling a chip with, generated right on the F-Ramune - so
+// filling (or blanking) a chip goes as fast as the chip can be written,
+// rather than as fast as the data can come in over serial. framune.py
+// generates the same patterns itself, to check the fill's CRC against, so
+// if one of these changes, change that too!
+
+// These numbers are what's sent over serial, so don't reorder them.
+enum FillPatternId : uint8_t
+{
+    // Every byte is the seed's lowest byte.
+    FILL_CONSTANT,
+    // The seed's lowest byte, then that plus 1, plus 2, and so on.
+    FILL_INCREMENTING,
+    // Every address's bytes XORed together, so every byte within 256 of
+    // another is different from it. The seed's ignored.
+    FILL_ADDRESS,
+    // The low byte of a 32-bit Galois LFSR (taps 32, 22, 2 and 1), stepped
+    // once before every byte, starting from the seed - 0 counts as 1, since
+    // an LFSR stays stuck at 0. Noise, as far as a chip's concerned.
+    FILL_LFSR,
+    FILL_NUM_PATTERNS
+};
+
+struct FillPattern
+{
+    uint8_t id;
+    uint32_t state;
+};
+
+// Returns false if there's no such pattern. address is where the fill
+// starts.
+bool initFillPattern(uint8_t id, uint32_t seed, uint32_t address, FillPattern* pattern);
+// Puts the pattern's next length bytes in dest.
+void fillPatternBytes(FillPattern* pattern, uint8_t* dest, size_t length);
+
+#endif
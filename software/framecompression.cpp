@@ -0,0 +1,133 @@
+#include "framecompression.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_LITERALS 0x40
+#define MAX_RUN 0x40
+#define MIN_MATCH 3
+#define MAX_MATCH (0x80 + MIN_MATCH - 1)
+// Where each 3-byte sequence was seen last, by hash, for finding matches.
+// Collisions just mean a match or two gets missed.
+#define RECENT_SIZE 16
+#define NOWHERE 0xFF
+
+static uint8_t hashOf(const uint8_t* data)
+{
+    return (data[0] ^ (data[1] << 1) ^ (data[2] >> 1) ^ (data[2] << 3)) &
+           (RECENT_SIZE - 1);
+}
+
+// Adds the literals from start to end to the compressed data, if they fit.
+static bool putLiterals(const uint8_t* start, const uint8_t* end,
+                        uint8_t* compressed, uint8_t& compressedLength,
+                        uint8_t maxLength)
+{
+    while (start < end) {
+        uint8_t count = end - start < MAX_LITERALS ? end - start : MAX_LITERALS;
+        if (compressedLength + 1 + count > maxLength) {
+            return false;
+        }
+        compressed[compressedLength++] = count - 1;
+        memcpy(compressed + compressedLength, start, count);
+        compressedLength += count;
+        start += count;
+    }
+    return true;
+}
+
+uint8_t compressFrame(const uint8_t* data, uint8_t length, uint8_t* compressed)
+{
+    uint8_t recent[RECENT_SIZE];
+    memset(recent, NOWHERE, sizeof(recent));
+    // Anything that doesn't come out smaller isn't worth it.
+    uint8_t maxLength = length - 1;
+    uint8_t compressedLength = 0;
+    uint8_t literalsStart = 0;
+    uint8_t i = 0;
+    while (i < length) {
+        uint8_t runLength = 1;
+        while (i + runLength < length && runLength < MAX_RUN &&
+               data[i + runLength] == data[i]) {
+            runLength++;
+        }
+        uint8_t matchLength = 0;
+        uint8_t matchStart = NOWHERE;
+        if (runLength < MAX_RUN && i + MIN_MATCH <= length) {
+            uint8_t hash = hashOf(data + i);
+            matchStart = recent[hash];
+            recent[hash] = i;
+        }
+        if (matchStart != NOWHERE) {
+            while (i + matchLength < length && matchLength < MAX_MATCH &&
+                   data[matchStart + matchLength] == data[i + matchLength]) {
+                matchLength++;
+            }
+        }
+
+        if (runLength < MIN_MATCH && matchLength < MIN_MATCH) {
+            i++;
+            continue;
+        }
+        if (!putLiterals(data + literalsStart, data + i, compressed,
+                         compressedLength, maxLength) ||
+            compressedLength + 2 > maxLength) {
+            return length;
+        }
+        if (runLength >= matchLength) {
+            compressed[compressedLength++] = 0x40 + runLength - 1;
+            compressed[compressedLength++] = data[i];
+            i += runLength;
+        } else {
+            compressed[compressedLength++] = 0x80 + matchLength - MIN_MATCH;
+            compressed[compressedLength++] = i - matchStart;
+            i += matchLength;
+        }
+        literalsStart = i;
+    }
+    if (!putLiterals(data + literalsStart, data + length, compressed,
+                     compressedLength, maxLength)) {
+        return length;
+    }
+    return compressedLength;
+}
+
+bool expandFrame(const uint8_t* compressed, uint8_t compressedLength,
+                 uint8_t* data, uint8_t length)
+{
+    const uint8_t* end = compressed + compressedLength;
+    uint8_t i = 0;
+    while (compressed < end) {
+        uint8_t token = *compressed++;
+        uint8_t count;
+        if (token < 0x40) {
+            count = token + 1;
+            if (end - compressed < count || length - i < count) {
+                return false;
+            }
+            memcpy(data + i, compressed, count);
+            compressed += count;
+        } else if (token < 0x80) {
+            count = token - 0x40 + 1;
+            if (compressed == end || length - i < count) {
+                return false;
+            }
+            memset(data + i, *compressed++, count);
+        } else {
+            count = token - 0x80 + MIN_MATCH;
+            if (compressed == end || length - i < count) {
+                return false;
+            }
+            uint8_t distance = *compressed++;
+            if (distance == 0 || distance > i) {
+                return false;
+            }
+            // A byte at a time, since the copy can overlap itself.
+            for (uint8_t j = 0; j < count; j++) {
+                data[i + j] = data[i + j - distance];
+            }
+        }
+        i += count;
+    }
+    return i == length;
+}
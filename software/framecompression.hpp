@@ -0,0 +1,30 @@
+#ifndef FRAMECOMPRESSION_HPP
+#define FRAMECOMPRESSION_HPP
+
+#include <stdint.h>
+
+// Compression for the frames that reads and writes send the data in (see
+// serialinterface.hpp), for when the host asks for it. Chips tend to be
+// full of runs of 0x00 or 0xFF, and of the same few bytes over and over,
+// so it's run-length encoding plus LZ77 within the frame - each frame's on
+// its own, so any of them can be sent again without the others. It's
+// cheap enough to keep up with the serial port, and needs no more RAM than
+// a few bytes of stack. framune.py does the same on its end, so if this
+// changes, change that too!
+//
+// The compressed data is a series of tokens:
+//   0x00-0x3F  the next (token + 1) bytes, as they are
+//   0x40-0x7F  the next byte, (token - 0x40 + 1) times
+//   0x80-0xFF  (token - 0x80 + 3) bytes copied from the next byte's worth
+//              of bytes back - which can overlap with the ones being copied
+
+// Compresses length bytes of data (128 at most) into compressed, which has
+// to have room for length - 1 bytes. Returns how many bytes that took - or
+// length, if it didn't take fewer, in which case compressed is garbage.
+uint8_t compressFrame(const uint8_t* data, uint8_t length, uint8_t* compressed);
+// Undoes compressFrame. Returns false if the compressed data doesn't come
+// out to exactly length bytes, and so must have been garbled.
+bool expandFrame(const uint8_t* compressed, uint8_t compressedLength,
+                 uint8_t* data, uint8_t length);
+
+#endif
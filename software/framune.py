@@ -5,6 +5,7 @@ import json
 import os
 import struct
 import sys
+import time
 import serial
 from binascii import crc32
 from collections import OrderedDict
@@ -13,7 +14,27 @@ from contextlib import contextmanager
 BAUD_RATE = 115200
 MIN_TIMEOUT = 1
 
-PROTOCOL_VERSION = 0
+# What the F-Ramune can switch to for transferring lots of data, fastest
+# first - all of them divide its 16 MHz clock evenly (see bufferedserial.hpp).
+FAST_BAUD_RATES = (2000000, 1000000, 500000)
+# These match serialinterface.hpp.
+BAUD_RATE_CHECK_SEQUENCE = b'\x55\xAA\xF0\x0F'
+BAUD_RATE_CHECK_SECONDS = 0.25
+BAUD_RATE_IDLE_SECONDS = 5
+
+# Reads and writes send the data in frames, each with its own CRC, so that
+# only the ones that get garbled have to be sent again. These match
+# serialinterface.hpp, and _sendFrame in serialinterface.cpp says what the
+# frames look like.
+FRAME_SIZE = 64
+FRAME_CANCEL, FRAME_START, FRAME_ACK, FRAME_NAK, FRAME_END, FRAME_FIN = \
+    range(0xF9, 0xFF)
+FRAME_TIMEOUT_SECONDS = 0.2
+FRAME_MAX_TIMEOUTS = 10
+# How the frames' data is sent - see framecompression.hpp.
+FRAME_RAW, FRAME_COMPRESSED = range(2)
+
+PROTOCOL_VERSION = 14
 ENDIANNESS = '>'
 
 def serial_without_dtr(port, *args, **kwargs):
@@ -29,10 +50,118 @@ def serial_without_dtr(port, *args, **kwargs):
         ser.open()
     return ser
 
-def appropriate_timeout(length):
+def appropriate_timeout(length, baud_rate=BAUD_RATE):
     """Return a reasonable timeout value for transferring `length`
-    bytes at F-Ramune's baud rate."""
-    return max(MIN_TIMEOUT, 1.5 * (length / (BAUD_RATE // 8)))
+    bytes at `baud_rate`."""
+    return max(MIN_TIMEOUT, 1.5 * (length / (baud_rate // 8)))
+
+def frame_span(address, length):
+    """Return the address of the first frame that a transfer of `length`
+    bytes at `address` is sent in, and how many frames it takes."""
+    first_address = address - address % FRAME_SIZE
+    if not length:
+        return first_address, 0
+    return first_address, -(-(address + length - first_address) // FRAME_SIZE)
+
+def frame_bytes(sequence, payload, is_compressed=False):
+    sequence &= 0xFF
+    data = payload
+    if is_compressed:
+        # With its length in front, which is FRAME_SIZE if it didn't get
+        # any shorter.
+        compressed = compress_frame(payload)
+        data = bytes((len(compressed or payload),)) + (compressed or payload)
+    return (bytes((FRAME_START, sequence, sequence ^ 0xFF)) + data +
+            struct.pack(ENDIANNESS + 'I', crc32(bytes((sequence,)) + payload)))
+
+def control_bytes(marker, sequence):
+    sequence &= 0xFF
+    return bytes((marker, sequence, sequence ^ 0xFF))
+
+# The same compression as in framecompression.cpp: runs and copies of
+# earlier bytes, within the frame.
+FRAME_MAX_LITERALS = 0x40
+FRAME_MAX_RUN = 0x40
+FRAME_MIN_MATCH = 3
+FRAME_MAX_MATCH = 0x80 + FRAME_MIN_MATCH - 1
+FRAME_RECENT_SIZE = 16
+
+def compress_frame(data):
+    """Return `data` compressed like the F-Ramune would (see
+    framecompression.hpp) - or None, if that doesn't make it shorter."""
+    length = len(data)
+    compressed = bytearray()
+    recent = [None] * FRAME_RECENT_SIZE
+    def put_literals(start, end):
+        for chunk_start in range(start, end, FRAME_MAX_LITERALS):
+            chunk = data[chunk_start:min(end, chunk_start + FRAME_MAX_LITERALS)]
+            compressed.append(len(chunk) - 1)
+            compressed.extend(chunk)
+
+    literals_start = 0
+    i = 0
+    while i < length:
+        run_length = 1
+        while (i + run_length < length and run_length < FRAME_MAX_RUN and
+               data[i + run_length] == data[i]):
+            run_length += 1
+        match_length = 0
+        match_start = None
+        if run_length < FRAME_MAX_RUN and i + FRAME_MIN_MATCH <= length:
+            hash_ = (data[i] ^ (data[i + 1] << 1) ^ (data[i + 2] >> 1) ^
+                     (data[i + 2] << 3)) & (FRAME_RECENT_SIZE - 1)
+            match_start = recent[hash_]
+            recent[hash_] = i
+        if match_start is not None:
+            while (i + match_length < length and match_length < FRAME_MAX_MATCH and
+                   data[match_start + match_length] == data[i + match_length]):
+                match_length += 1
+
+        if run_length < FRAME_MIN_MATCH and match_length < FRAME_MIN_MATCH:
+            i += 1
+            continue
+        put_literals(literals_start, i)
+        if run_length >= match_length:
+            compressed.extend((0x40 + run_length - 1, data[i]))
+            i += run_length
+        else:
+            compressed.extend((0x80 + match_length - FRAME_MIN_MATCH, i - match_start))
+            i += match_length
+        literals_start = i
+    put_literals(literals_start, length)
+    return bytes(compressed) if len(compressed) < length else None
+
+def expand_frame(compressed, length=FRAME_SIZE):
+    """Undo compress_frame, and return the `length` bytes that come out -
+    or None, if they don't, and the compressed data must be garbled."""
+    data = bytearray()
+    i = 0
+    while i < len(compressed):
+        token = compressed[i]
+        if token < 0x40:
+            count = token + 1
+            data.extend(compressed[i + 1:i + 1 + count])
+            i += 1 + count
+        elif i + 1 >= len(compressed):
+            return None
+        elif token < 0x80:
+            data.extend(compressed[i + 1:i + 2] * (token - 0x40 + 1))
+            i += 2
+        else:
+            distance = compressed[i + 1]
+            if distance == 0 or distance > len(data):
+                return None
+            # A byte at a time, since the copy can overlap itself.
+            for _ in range(token - 0x80 + FRAME_MIN_MATCH):
+                data.append(data[-distance])
+            i += 2
+        if len(data) > length:
+            return None
+    return bytes(data) if len(data) == length and i == len(compressed) else None
+
+# How long a single read or write of a march test takes, at most. Really,
+# they're more like 10 µs, but better safe than timed out.
+MARCH_TEST_SECONDS_PER_OPERATION = 0.00005
 
 @contextmanager
 def temp_timeout(ser, timeout):
@@ -41,6 +170,65 @@ def temp_timeout(ser, timeout):
     yield
     ser.timeout = original_timeout
 
+# How long filling takes per byte, at most: an EEPROM's 10 ms write cycle
+# per 64-byte page, plus a bit.
+FILL_SECONDS_PER_BYTE = 0.0002
+
+# How long the F-Ramune takes to read and CRC a byte for a digest, at most.
+# It's more like 15 µs, but nothing comes back until it's done with all of
+# them, so there's no telling it's still at it.
+DIGEST_SECONDS_PER_BYTE = 0.00005
+
+# These match fillpattern.hpp.
+FILL_PATTERNS = OrderedDict((
+    ('constant',     0),
+    ('incrementing', 1),
+    ('address',      2),
+    ('lfsr',         3)
+))
+FILL_LFSR_TAPS = 0x80200003
+
+def fill_pattern_bytes(pattern, seed, address, length):
+    """Return the `length` bytes the F-Ramune fills with for `pattern`,
+    starting at `address`."""
+    if pattern == FILL_PATTERNS['constant']:
+        return bytes([seed & 0xFF]) * length
+    if pattern == FILL_PATTERNS['incrementing']:
+        return bytes((seed + i) & 0xFF for i in range(length))
+    if pattern == FILL_PATTERNS['address']:
+        return bytes((a ^ a >> 8 ^ a >> 16 ^ a >> 24) & 0xFF
+                     for a in range(address, address + length))
+    if pattern == FILL_PATTERNS['lfsr']:
+        state = seed & 0xFFFFFFFF or 1
+        data = bytearray(length)
+        for i in range(length):
+            state = state >> 1 ^ FILL_LFSR_TAPS if state & 1 else state >> 1
+            data[i] = state & 0xFF
+        return bytes(data)
+    raise ValueError("No such fill pattern.")
+
+# How many address lines the 74HC595s each drive.
+SHIFT_REGISTER_BITS = 8
+
+# These match marchtest.hpp.
+MARCH_ALGORITHMS = OrderedDict((
+    ('mats+',    0),
+    ('march-c-', 1),
+    ('march-ss', 2)
+))
+MARCH_FAULTS = (
+    'stuck-at',
+    'transition',
+    'address decoder',
+    'inversion coupling',
+    'idempotent coupling',
+    'state coupling',
+    'read destructive',
+    'deceptive read destructive',
+    'incorrect read',
+    'write disturb'
+)
+
 class Framune(object):
     def __init__(self, serial_port):
         if hasattr(serial_port, 'port'):
@@ -52,6 +240,12 @@ class Framune(object):
                                               timeout=MIN_TIMEOUT,
                                               inter_byte_timeout=MIN_TIMEOUT)
         self._chip = MemoryChip(None, None, None, None, framune=self)
+        # When something last came in, for knowing whether the F-Ramune's
+        # gone back to the default baud rate by itself.
+        self._last_received = time.monotonic()
+        # Whether to ask for reads and writes to be compressed. The F-Ramune
+        # can still say no, if it's busy with something else.
+        self.compression = True
     
     def __enter__(self):
         return self
@@ -60,6 +254,12 @@ class Framune(object):
         self.close()
 
     def close(self):
+        if self._serial.baudrate != BAUD_RATE:
+            # Otherwise, it'd take the F-Ramune a few seconds to notice.
+            try:
+                self.set_baud_rate(BAUD_RATE)
+            except (TimeoutError, ConnectionError):
+                pass
         self._serial.close()
     
     @property
@@ -78,6 +278,7 @@ class Framune(object):
         except (serial.SerialTimeoutException, TimeoutError):
             raise TimeoutError("F-Ramune did not respond in time.")
         else:
+            self._last_received = time.monotonic()
             return data
     
     def _write(self, data):
@@ -108,6 +309,17 @@ class Framune(object):
         self._write_uint(ENDIANNESS + 'I', n)
 
     def _command(self, command):
+        if (self._serial.baudrate != BAUD_RATE and time.monotonic() -
+                self._last_received > BAUD_RATE_IDLE_SECONDS - MIN_TIMEOUT):
+            # It might or might not have gone back to the default baud rate
+            # already, so wait until it definitely has.
+            time.sleep(max(0, self._last_received + BAUD_RATE_IDLE_SECONDS +
+                           MIN_TIMEOUT - time.monotonic()))
+            self._serial.baudrate = BAUD_RATE
+            self._serial.reset_input_buffer()
+        # Anything still coming in is left over from the last command - an
+        # END sent again because the FIN got lost, say.
+        self._serial.reset_input_buffer()
         self._write_byte(command)
         if self._read_byte() == command:
             self._write_byte(0x00)
@@ -139,6 +351,74 @@ class Framune(object):
     def analyze(self):
         self._set_and_analyze_chip(MemoryChip(None, None, None, None))
 
+    def set_baud_rate(self, baud_rate):
+        """Switch both the F-Ramune and the serial port to `baud_rate`, and
+        return True - or if that doesn't work, leave both at the baud rate
+        they were at, and return False. The F-Ramune goes back to the
+        default baud rate by itself after BAUD_RATE_IDLE_SECONDS without a
+        command, and this keeps track of that too."""
+        self._command(0x0D)
+        self._write_uint32(baud_rate)
+        if not self._read_byte():
+            return False
+
+        # The F-Ramune's switched over by the time the OK's here.
+        old_baud_rate = self._serial.baudrate
+        self._serial.baudrate = baud_rate
+        self._serial.reset_input_buffer()
+        self._write(BAUD_RATE_CHECK_SEQUENCE)
+        try:
+            with temp_timeout(self._serial, 2 * BAUD_RATE_CHECK_SECONDS):
+                echo = self._read(len(BAUD_RATE_CHECK_SEQUENCE))
+        except TimeoutError:
+            echo = None
+        if echo == BAUD_RATE_CHECK_SEQUENCE:
+            return True
+
+        # The F-Ramune's given up too, by now. Unless the echo is all that
+        # got garbled - then it's still at the new baud rate until it's been
+        # idle for long enough.
+        self._serial.baudrate = old_baud_rate
+        time.sleep(BAUD_RATE_CHECK_SECONDS)
+        self._serial.reset_input_buffer()
+        try:
+            self.get_version()
+        except (TimeoutError, ConnectionError):
+            time.sleep(BAUD_RATE_IDLE_SECONDS)
+            self._serial.reset_input_buffer()
+        return False
+
+    def negotiate_baud_rate(self, baud_rates=FAST_BAUD_RATES):
+        """Switch to the first of `baud_rates` that works, and return it - or
+        if none do, stay at the current baud rate, and return that."""
+        for baud_rate in baud_rates:
+            if self.set_baud_rate(baud_rate):
+                return baud_rate
+        return self._serial.baudrate
+
+    def measure_retention(self):
+        """Power the chip off for longer and longer, and return how many of
+        a sample of its cells lost their data each time, as a list of
+        (microseconds off, cells lost) pairs, along with the sample size.
+        """
+        self._command(0x08)
+        # The longest step alone is 64 ms with the defaults - but it could
+        # be set higher than that.
+        with temp_timeout(self._serial, 10 * MIN_TIMEOUT):
+            num_samples = self._read_uint16()
+        if not num_samples:
+            raise ConnectionError("The F-Ramune couldn't measure the retention.")
+        num_steps = self._read_byte()
+        points = [(self._read_uint32(), self._read_uint16()) for _ in range(num_steps)]
+        return num_samples, points
+
+    def get_address_width(self):
+        """Return how many address lines the F-Ramune drives - in other
+        words, the biggest chip it can handle is 2 ** that bytes.
+        """
+        self._command(0x07)
+        return self._read_byte()
+
     def read(self, address, length):
         """Return up to `length` bytes read starting at `address` from
         the memory chip currently connected to the F-Ramune.
@@ -146,38 +426,165 @@ class Framune(object):
         self._command(0x02)
         self._write_uint32(address)
         self._write_uint32(length)
+        self._write_byte(FRAME_COMPRESSED if self.compression else FRAME_RAW)
         length = self._read_uint32()
+        self._read_byte() # The window - it's all the same to this end.
+        is_compressed = self._read_byte() == FRAME_COMPRESSED
 
-        with temp_timeout(self._serial, appropriate_timeout(length)):
-            data = self._read(length)
-        
-        received_crc = self._read_uint32()
-        computed_crc = crc32(data)
-        if received_crc != computed_crc:
-            raise ConnectionError("The computed checksum didn't match the one "
-                                  "received from the F-Ramune.")
-        
-        return data
+        first_address, count = frame_span(address, length)
+        payloads = [None] * count
+        first_missing = 0
+        # The F-Ramune sends frames again until they're ACKed, so there's
+        # nothing to do but wait for them - unless it's given up.
+        with temp_timeout(self._serial,
+                          (FRAME_MAX_TIMEOUTS + 1) * FRAME_TIMEOUT_SECONDS):
+            while True:
+                marker, sequence, payload = self._receive_framed(is_compressed)
+                if marker == FRAME_END and first_missing == count:
+                    self._write(control_bytes(FRAME_FIN, sequence))
+                    break
+                if marker != FRAME_START:
+                    continue
+                # The F-Ramune's window can be a bit behind, if ACKs are on
+                # their way - or got lost.
+                offset = (sequence - first_missing) & 0xFF
+                index = first_missing + (offset - 0x100 if offset >= 0x80 else offset)
+                if index < 0 or index >= count:
+                    continue
+                if payloads[index] is None:
+                    if payload is None:
+                        self._write(control_bytes(FRAME_NAK, sequence))
+                        continue
+                    payloads[index] = payload
+                while first_missing < count and payloads[first_missing] is not None:
+                    first_missing += 1
+                self._write(control_bytes(FRAME_ACK, sequence))
+
+        start = address - first_address
+        return b''.join(payloads)[start:start + length]
+
+    def _receive_framed(self, is_compressed=False):
+        """Return the next frame or control message that comes in, as
+        (marker, sequence number, payload) - where the payload's None for
+        control messages, and for frames that came in damaged but with
+        their sequence number intact. Anything else gets skipped. Frames'
+        payloads come out expanded, if they're compressed."""
+        while True:
+            marker = self._read_byte()
+            if marker < FRAME_CANCEL or marker > FRAME_FIN:
+                continue
+            header = self._read(2)
+            if header[0] ^ header[1] != 0xFF:
+                continue
+            if marker != FRAME_START:
+                return marker, header[0], None
+            # Bytes that got lost on the way would leave this waiting for
+            # ones from the next frame, which might never come.
+            with temp_timeout(self._serial, FRAME_TIMEOUT_SECONDS):
+                payload_length = FRAME_SIZE
+                if is_compressed:
+                    payload_length = (self._serial.read(1) or b'\0')[0]
+                    if not 0 < payload_length <= FRAME_SIZE:
+                        return marker, header[0], None
+                rest = self._serial.read(payload_length + 4)
+            if len(rest) < payload_length + 4:
+                return marker, header[0], None
+            payload = rest[:payload_length]
+            if payload_length < FRAME_SIZE:
+                payload = expand_frame(payload)
+                if payload is None:
+                    return marker, header[0], None
+            received_crc, = struct.unpack(ENDIANNESS + 'I', rest[payload_length:])
+            if crc32(header[:1] + payload) != received_crc:
+                return marker, header[0], None
+            return marker, header[0], payload
     
     def write(self, address, data):
         """Write the bytes `data` to the memory chip currently connected to
-        the F-Ramune, starting at `address`."""
+        the F-Ramune, starting at `address`. Return how many got written."""
+        return self._write_data(0x03, address, data)
+
+    def write_changes(self, address, data):
+        """Like write, but have the F-Ramune leave the bytes that are already
+        right alone - quicker on EEPROMs, and easier on them too. Return how
+        many bytes got written, and how many of those actually changed."""
+        length = self._write_data(0x09, address, data)
+        return length, self._read_uint32()
+
+    def _write_data(self, command, address, data):
         length = len(data)
-        self._command(0x03)
-        # Unused at the moment. Who needs EEPROM support anyway...
-        is_slow = self._read_byte()
+        self._command(command)
         self._write_uint32(address)
         self._write_uint32(length)
+        self._write_byte(FRAME_COMPRESSED if self.compression else FRAME_RAW)
         length = self._read_uint32()
+        window = self._read_byte()
+        is_compressed = self._read_byte() == FRAME_COMPRESSED
         data = data[:length]
 
-        with temp_timeout(self._serial, appropriate_timeout(length)):
-            self._write(data)
-            # Receiving the CRC really only transfers 4 bytes, but the F-Ramune
-            # operates on all of the bytes written to compute it, so it takes
-            # time, and thus needs a more lenient timeout. appropriate_timeout
-            # does that job well enough (it's a bit too lenient here, even).
-            received_crc = self._read_uint32()
+        # The frames line up with multiples of FRAME_SIZE, so the first and
+        # last ones get padded out.
+        first_address, count = frame_span(address, length)
+        start = address - first_address
+        padded = bytes(start) + data + bytes(count * FRAME_SIZE - start - length)
+        def send(index):
+            self._write(frame_bytes(
+                index, padded[index * FRAME_SIZE:(index + 1) * FRAME_SIZE], is_compressed))
+
+        is_acked = [False] * count
+        first_unacked = 0
+        next_index = 0
+        timeouts = 0
+        with temp_timeout(self._serial, FRAME_TIMEOUT_SECONDS):
+            while True:
+                # Only as many as the window allows - any more, and the
+                # F-Ramune's receive buffer would overflow.
+                while next_index < count and next_index - first_unacked < window:
+                    send(next_index)
+                    next_index += 1
+                try:
+                    marker, sequence, _ = self._receive_framed()
+                except TimeoutError:
+                    # The frames or their ACKs got lost, so off they go again.
+                    timeouts += 1
+                    if timeouts > FRAME_MAX_TIMEOUTS:
+                        raise
+                    for index in range(first_unacked, next_index):
+                        if not is_acked[index]:
+                            send(index)
+                    continue
+                index = first_unacked + ((sequence - first_unacked) & 0xFF)
+                if marker == FRAME_END and sequence == count & 0xFF:
+                    # Everything's been written, even if the last ACKs got lost.
+                    self._write(control_bytes(FRAME_FIN, sequence))
+                    break
+                elif marker == FRAME_CANCEL:
+                    raise ConnectionError(
+                        "Writing the frame at 0x{:X} failed. Is the EEPROM's data "
+                        "protection set right?".format(first_address + index * FRAME_SIZE))
+                elif index >= next_index:
+                    continue
+                elif marker == FRAME_ACK:
+                    is_acked[index] = True
+                    timeouts = 0
+                    while first_unacked < count and is_acked[first_unacked]:
+                        first_unacked += 1
+                elif marker == FRAME_NAK and not is_acked[index]:
+                    send(index)
+
+        # Receiving the CRC really only transfers 4 bytes, but the F-Ramune
+        # operates on all of the bytes written to compute it, so it takes
+        # time, and thus needs a more lenient timeout. appropriate_timeout
+        # does that job well enough (it's a bit too lenient here, even).
+        timeout = appropriate_timeout(length, self._serial.baudrate)
+        with temp_timeout(self._serial, timeout):
+            # The F-Ramune sends END again if the FIN got lost.
+            while True:
+                received = self._read(3)
+                if received != control_bytes(FRAME_END, count):
+                    break
+                self._write(control_bytes(FRAME_FIN, count))
+            received_crc, = struct.unpack(ENDIANNESS + 'I', received + self._read(1))
         error_code = self._read_byte()
         computed_crc = crc32(data)
         if received_crc != computed_crc:
@@ -188,6 +595,177 @@ class Framune(object):
                                   "Is there really a memory chip connected?")
         return length
 
+    def fill(self, address, length, pattern=FILL_PATTERNS['constant'], seed=0xFF):
+        """Fill `length` bytes starting at `address` with one of the
+        FILL_PATTERNS, generated on the F-Ramune itself, so it's as quick as
+        the chip can be written. For the constant and incrementing patterns,
+        `seed`'s lowest byte is the (first) value; for the LFSR, it's the
+        starting state. Return how many bytes got filled."""
+        self._command(0x0A)
+        self._write_byte(pattern)
+        self._write_uint32(seed)
+        self._write_uint32(address)
+        self._write_uint32(length)
+        if not self._read_byte():
+            raise ValueError("The F-Ramune doesn't know that pattern.")
+        length = self._read_uint32()
+
+        timeout = max(MIN_TIMEOUT, length * FILL_SECONDS_PER_BYTE)
+        with temp_timeout(self._serial, timeout):
+            is_written = self._read_byte()
+        received_crc = self._read_uint32()
+        if not is_written:
+            raise ConnectionError("Filling failed partway. Is the EEPROM's "
+                                  "data protection set right?")
+        if received_crc != crc32(fill_pattern_bytes(pattern, seed, address, length)):
+            raise ConnectionError("The chip didn't read back as filled. "
+                                  "Is there really a memory chip connected?")
+        return length
+
+    def get_digest(self, address, length):
+        """Return how many of the `length` bytes starting at `address` there
+        are on the chip, and their CRC32 - computed on the F-Ramune, so only
+        the CRC comes over serial."""
+        self._command(0x0C)
+        self._write_uint32(address)
+        self._write_uint32(length)
+        length = self._read_uint32()
+        timeout = max(MIN_TIMEOUT, length * DIGEST_SECONDS_PER_BYTE)
+        with temp_timeout(self._serial, timeout):
+            return length, self._read_uint32()
+
+    def verify(self, address, data):
+        """Return True if the chip holds `data` starting at `address`."""
+        length, digest = self.get_digest(address, len(data))
+        return length == len(data) and digest == crc32(data)
+
+    def get_block_checksums(self, address, length, block_size=256):
+        """Return the CRC32s of the `block_size`-byte blocks of the `length`
+        bytes starting at `address`, computed on the F-Ramune in one pass -
+        so comparing a chip to an image takes 4 bytes per block over serial,
+        not the whole thing. The last block may be shorter."""
+        self._command(0x0B)
+        self._write_uint16(block_size)
+        self._write_uint32(address)
+        self._write_uint32(length)
+        if not self._read_byte():
+            raise ValueError("The block size can't be 0.")
+        length = self._read_uint32()
+        return [self._read_uint32() for _ in range(0, length, block_size)]
+
+    def differing_blocks(self, address, data, block_size=256):
+        """Return the stretches of `data` that differ from the chip starting
+        at `address`, as a list of (offset, length) pairs - whole blocks,
+        with neighbors joined together. A stretch past the end of the chip
+        counts as differing."""
+        checksums = self.get_block_checksums(address, len(data), block_size)
+        stretches = []
+        for offset in range(0, len(data), block_size):
+            i = offset // block_size
+            block = data[offset:offset + block_size]
+            if i < len(checksums) and checksums[i] == crc32(block):
+                continue
+            if stretches and sum(stretches[-1]) == offset:
+                stretches[-1] = (stretches[-1][0], stretches[-1][1] + len(block))
+            else:
+                stretches.append((offset, len(block)))
+        return stretches
+
+    def get_stats(self):
+        """Return the F-Ramune's performance counters as an OrderedDict,
+        and reset them. Return None if it was built without them.
+        """
+        self._command(0x04)
+        is_enabled = self._read_byte()
+        num_counters = self._read_byte()
+        values = [self._read_uint32() for _ in range(num_counters)]
+        if not is_enabled:
+            return None
+        # Firmware that's newer than this script might have more counters.
+        names = [name for name, label in STATS_COUNTERS]
+        names += ["counter_{}".format(i) for i in range(len(names), num_counters)]
+        return OrderedDict(zip(names, values))
+
+    def test(self, address, length, algorithm=MARCH_ALGORITHMS['march-c-']):
+        """Run a march test on `length` bytes starting at `address`, and
+        return the results as an OrderedDict. Since the tests are transparent,
+        the chip's contents are left as they were.
+        """
+        self._command(0x05)
+        self._write_byte(algorithm)
+        self._write_uint32(address)
+        self._write_uint32(length)
+        if not self._read_byte():
+            raise ValueError("The F-Ramune doesn't know that algorithm.")
+        length = self._read_uint32()
+        coverage = self._read_uint16()
+        operations_per_cell = self._read_byte()
+
+        timeout = max(MIN_TIMEOUT, operations_per_cell * length *
+                      MARCH_TEST_SECONDS_PER_OPERATION)
+        with temp_timeout(self._serial, timeout):
+            passed = bool(self._read_byte())
+        mismatches = self._read_uint32()
+        first_mismatch_address = self._read_uint32()
+        failed_elements = self._read_uint16()
+        return OrderedDict((
+            ('size', length),
+            ('detects', [name for i, name in enumerate(MARCH_FAULTS)
+                         if coverage & (1 << i)]),
+            ('passed', passed),
+            ('mismatches', mismatches),
+            ('first_mismatch_address',
+                first_mismatch_address if mismatches else None),
+            ('failed_elements', [i for i in range(16) if failed_elements & (1 << i)])
+        ))
+
+    def diagnose(self, address_width=0):
+        """Check each of the data and address lines for being stuck or
+        shorted, and return the faulty lines as an OrderedDict of lists.
+        With an `address_width` of 0, the F-Ramune goes by the chip's size.
+        """
+        self._command(0x06)
+        self._write_byte(address_width)
+        if not self._read_byte():
+            raise ConnectionError("The F-Ramune couldn't run the diagnosis.")
+        lines = lambda mask, width: [i for i in range(width) if mask & (1 << i)]
+        data_stuck_low = lines(self._read_byte(), 8)
+        data_stuck_high = lines(self._read_byte(), 8)
+        data_shorted = lines(self._read_byte(), 8)
+        address_width = self._read_byte()
+        addresses_tested = bool(self._read_byte())
+        address_stuck = lines(self._read_uint32(), address_width)
+        address_shorted = lines(self._read_uint32(), address_width)
+        return OrderedDict((
+            ('data_stuck_low', data_stuck_low),
+            ('data_stuck_high', data_stuck_high),
+            ('data_shorted', data_shorted),
+            ('address_width', address_width),
+            ('addresses_tested', addresses_tested),
+            ('address_stuck', address_stuck),
+            ('address_shorted', address_shorted)
+        ))
+
+# In the order the F-Ramune sends them in (see stats.hpp).
+STATS_COUNTERS = (
+    ('bytes_read',             "Bytes read:             "),
+    ('bytes_written',          "Bytes written:          "),
+    ('mode_switches',          "Mode switches:          "),
+    ('power_cycles',           "Power cycles:           "),
+    ('serial_timeouts',        "Serial timeouts:        "),
+    ('micros_analyzing',       "Analyzing:              "),
+    ('micros_reading',         "Reading:                "),
+    ('micros_writing',         "Writing:                "),
+    ('micros_receiving',       "  Waiting for data:     "),
+    ('micros_verifying',       "Verifying writes:       "),
+    ('micros_pull_up_check',   "Checking for pull-ups:  "),
+    ('micros_testing',         "Testing:                "),
+    ('stack_bytes_never_used', "Stack never used:       "),
+    ('serial_errors',          "Serial errors:          "),
+    ('serial_rx_buffer_peak',  "Serial buffer peak:     "),
+    ('frames_resent',          "Frames resent:          ")
+)
+
 def framune_updating_property(internal_name):
     def getter(self):
         return getattr(self, internal_name)
@@ -203,7 +781,10 @@ MEMORY_CHIP_DATA_STRUCTURE = OrderedDict((
     ('is_operational', '?'),
     ('size', 'I'),
     ('is_nonvolatile', '?'),
-    ('is_eeprom', '?')
+    ('is_eeprom', '?'),
+    ('power_on_settle_micros', 'H'),
+    ('strobe_micros', 'B'),
+    ('uses_data_protection', '?')
 ))
 MEMORY_CHIP_DATA_STRUCTURE_FMT = ENDIANNESS + \
     ''.join(MEMORY_CHIP_DATA_STRUCTURE.values())
@@ -215,11 +796,16 @@ MEMORY_CHIP_KNOWN_DATA_STRUCTURE_SIZE = \
     struct.calcsize(MEMORY_CHIP_KNOWN_DATA_STRUCTURE_FMT)
 class MemoryChip(object):
     def __init__(self, is_operational=None, size=None,
-                 is_nonvolatile=None, is_eeprom=None, framune=None):
+                 is_nonvolatile=None, is_eeprom=None,
+                 power_on_settle_micros=None, strobe_micros=None,
+                 uses_data_protection=None, framune=None):
         self._is_operational = is_operational
         self._size = size
         self._is_nonvolatile = is_nonvolatile
         self._is_eeprom = is_eeprom
+        self._power_on_settle_micros = power_on_settle_micros
+        self._strobe_micros = strobe_micros
+        self._uses_data_protection = uses_data_protection
         self._framune = framune
 
     @classmethod
@@ -241,6 +827,9 @@ class MemoryChip(object):
     size           = framune_updating_property('_size')
     is_nonvolatile = framune_updating_property('_is_nonvolatile')
     is_eeprom      = framune_updating_property('_is_eeprom')
+    power_on_settle_micros = framune_updating_property('_power_on_settle_micros')
+    strobe_micros  = framune_updating_property('_strobe_micros')
+    uses_data_protection = framune_updating_property('_uses_data_protection')
 
     def known_status_to_bytes(self):
         return bytes(int(getattr(self, attr) is not None)
@@ -287,12 +876,19 @@ def main(*argv):
     parser = KindArgumentParser(
         prog=script_name,
         usage="%(prog)s [-h] [--analyze] [--no-version-check] <port> "
-              "<version|analyze|read|write> ...",
+              "<version|analyze|read|write|verify|sync|fill|erase|test|diagnose|retention|"
+              "stats> ...",
         description="Interface with an F-Ramune (memory chip programmer and tester).\n\n"
         "Examples:\n"
         "%(prog)s COM5 analyze\n"
         "%(prog)s /dev/ttyS2 read -a 0x1000 -s 0x100 -o data.hex\n"
-        "%(prog)s /dev/tty.usbserial-A6004byf write -i data.hex",
+        "%(prog)s /dev/tty.usbserial-A6004byf write -i data.hex\n"
+        "%(prog)s COM5 --analyze write --diff -i save.bin\n"
+        "%(prog)s COM5 verify -i save.bin\n"
+        "%(prog)s COM5 sync -i save.bin\n"
+        "%(prog)s COM5 --analyze fill --pattern lfsr --seed 1234\n"
+        "%(prog)s COM5 --analyze test --algorithm march-ss\n"
+        "%(prog)s COM5 diagnose -s 0x8000",
         formatter_class=ProperHelpFormatter,
         add_help=False
     )
@@ -320,8 +916,16 @@ def main(*argv):
     )
     parser.add_argument(
         'command', metavar='command',
-        help="What to do. Valid commands are: \"version\", \"analyze\", \"read\", and \"write\".",
-        choices=('version', 'analyze', 'read', 'write')
+        help="What to do. Valid commands are: \"version\", \"analyze\", \"read\", \"write\",\n"
+             "\"verify\" (checks that the chip holds a file, without reading it all out),\n"
+             "\"sync\" (only writes - or with -o, only reads - the blocks that differ),\n"
+             "\"fill\" (fills the chip with a pattern), \"erase\" (fills it with 0xFF),\n"
+             "\"test\" (runs a march test, leaving the data intact), \"diagnose\" (quickly\n"
+             "finds stuck or shorted data and address lines), \"retention\" (shows how\n"
+             "quickly the chip loses its data with the power off - for telling fake FRAM\n"
+             "from the real deal), and \"stats\" (shows and resets performance counters).",
+        choices=('version', 'analyze', 'read', 'write', 'verify', 'sync', 'fill', 'erase',
+                 'test', 'diagnose', 'retention', 'stats')
     )
     parser.add_argument(
         '-h', '--help',
@@ -340,27 +944,75 @@ def main(*argv):
     )
     parser.add_argument(
         '-a', '--address', metavar='address', type=int_of_any_base, default=0,
-        help="Used with the \"read\" and \"write\" commands. The address to start at."
-             "Defaults to 0."
+        help="Used with the \"read\", \"write\", \"verify\", \"sync\", \"fill\", \"erase\" and\n"
+             "\"test\" commands. The address to start at. Defaults to 0."
     )
     parser.add_argument(
         '-s', '--size', metavar='size', type=int_of_any_base, default=None,
-        help="Used with the \"read\" and \"write\" commands. The number of bytes."
-             "Required for reading if not using --analyze."
+        help="Used with the \"read\", \"write\", \"verify\", \"sync\", \"fill\", \"erase\",\n"
+             "\"test\" and \"diagnose\" commands. The number of bytes. Required for reading,\n"
+             "filling, erasing and testing if not using --analyze. For syncing to a file\n"
+             "with -o, how big the file ends up - the chip's size, by default. For\n"
+             "diagnosing, the chip's full size - a broken address line makes --analyze get\n"
+             "the size wrong, so it's best given."
     )
     parser.add_argument(
         '-i', metavar='path',
-        help="Used with the \"write\" command. The file to get the data to write from.\n"
-             "By omitting this and piping input, the data can be gotten from stdin."
+        help="Used with the \"write\", \"verify\" and \"sync\" commands. The file to get the\n"
+             "data to write (or check) from. By omitting this and piping input, the data\n"
+             "can be gotten from stdin (except for syncing)."
+    )
+    parser.add_argument(
+        '--diff', action='store_true',
+        help="Used with the \"write\" command. Only write the bytes that differ from what's\n"
+             "already on the chip. Much quicker for mostly unchanged data on EEPROMs, and\n"
+             "wears them less, too."
     )
     parser.add_argument(
         '-o', metavar='path',
-        help="Used with the \"read\" command. The file to save the read data to.\n"
-             "By omitting this and piping output, the data can be output to stdout."
+        help="Used with the \"read\" and \"sync\" commands. The file to save the read data\n"
+             "to. By omitting this and piping output, the data can be output to stdout\n"
+             "(except for syncing, which updates the file in place)."
+    )
+    parser.add_argument(
+        '--block-size', metavar='size', type=int_of_any_base, default=256,
+        help="Used with the \"sync\" command. How big the blocks compared are - smaller\n"
+             "ones send less data for scattered changes, but take more checksums.\n"
+             "Defaults to 256."
+    )
+    parser.add_argument(
+        '--baud-rate', metavar='rate', type=int, default=None,
+        help="Used with the \"read\", \"write\" and \"sync\" commands. The baud rate to\n"
+             "switch to for the transfer. Defaults to the fastest that works of\n"
+             "{}. {} stays at the default.\n"
+             "Never switches with --no-version-check.".format(
+                 ", ".join(str(r) for r in FAST_BAUD_RATES), BAUD_RATE)
+    )
+    parser.add_argument(
+        '--no-compression', action='store_true',
+        help="Used with the \"read\", \"write\" and \"sync\" commands. Send the data as\n"
+             "it is, rather than compressed. Compressing costs a byte per frame that\n"
+             "doesn't get any shorter, but mostly blank chips go several times as fast."
     )
     parser.add_argument(
         '-j', '--json', action='store_true',
-        help="Used with the \"analyze\" command. Outputs the chip information in JSON form."
+        help="Used with the \"analyze\", \"test\", \"diagnose\", \"retention\" and \"stats\"\n"
+             "commands. Outputs the information in JSON form."
+    )
+    parser.add_argument(
+        '--pattern', choices=tuple(FILL_PATTERNS), default='constant',
+        help="Used with the \"fill\" command. What to fill with: \"constant\" (the seed, the\n"
+             "default), \"incrementing\" (counting up from the seed), \"address\" (each\n"
+             "address's bytes XORed together), or \"lfsr\" (noise, seeded with the seed)."
+    )
+    parser.add_argument(
+        '--seed', metavar='seed', type=int_of_any_base, default=0xFF,
+        help="Used with the \"fill\" command. See --pattern. Defaults to 0xFF."
+    )
+    parser.add_argument(
+        '--algorithm', choices=tuple(MARCH_ALGORITHMS), default='march-c-',
+        help="Used with the \"test\" command. Which march test to run: \"mats+\" (quick),\n"
+             "\"march-c-\" (the default), or \"march-ss\" (thorough, but more than twice as slow)."
     )
 
     arguments = parser.parse_args(argv)
@@ -369,12 +1021,20 @@ def main(*argv):
         print("No output specified! Please either specify -o or pipe output.",
               file=sys.stderr)
         return 1
-    if arguments.command == 'write' and arguments.i is None and sys.stdin.isatty():
+    if arguments.command == 'sync' and (arguments.i is None) == (arguments.o is None):
+        print("Please specify either -i (to sync the chip to a file) or -o (to sync a file "
+              "to the chip).", file=sys.stderr)
+        return 1
+    if arguments.command == 'sync' and arguments.block_size < 1:
+        print("The block size has to be at least 1.", file=sys.stderr)
+        return 1
+    if arguments.command in ('write', 'verify') and arguments.i is None and sys.stdin.isatty():
         print("No input specified! Please either specify -i or pipe input.",
               file=sys.stderr)
         return 1
-    if arguments.command == 'read' and not (arguments.analyze or arguments.size is not None):
-        print("No size specified for read! Either specify -s or --analyze.",
+    if (arguments.command in ('read', 'fill', 'erase', 'test') and
+            not (arguments.analyze or arguments.size is not None)):
+        print("No size specified for {}! Either specify -s or --analyze.".format(arguments.command),
               file=sys.stderr)
         return 1
 
@@ -395,6 +1055,20 @@ def main(*argv):
         
         if arguments.analyze and not arguments.command == 'analyze':
             framune.analyze()
+        framune.compression = not arguments.no_compression
+
+        # Only for commands that transfer lots of data - everything else is
+        # over before switching would pay off.
+        if (not arguments.no_version_check and arguments.baud_rate != BAUD_RATE and
+                arguments.command in ('read', 'write', 'sync')):
+            if arguments.baud_rate is not None:
+                baud_rates = (arguments.baud_rate,)
+            else:
+                baud_rates = FAST_BAUD_RATES
+            if (framune.negotiate_baud_rate(baud_rates) == BAUD_RATE and
+                    arguments.baud_rate is not None):
+                print("Couldn't switch to {} baud, so staying at {}.".format(
+                    arguments.baud_rate, BAUD_RATE), file=sys.stderr)
         
         if arguments.command == 'version':
             print(framune.get_version())
@@ -402,27 +1076,105 @@ def main(*argv):
 
         if arguments.command == 'analyze':
             framune.analyze()
+            address_width = framune.get_address_width()
             if arguments.json:
                 properties = OrderedDict(
                     (k, getattr(framune.chip, k))
                     for k in MEMORY_CHIP_DATA_STRUCTURE
                 )
+                properties['max_size'] = 2 ** address_width
                 print(json.dumps(properties, indent=4))
             else:
                 yn = lambda x: "Yes" if x else "No"
+                us = lambda x: "{} µs".format(x)
                 rows = (
                     ('is_operational', "Is operational:  ", yn),
                     ('size',           "Size:            ", format_size),
                     ('is_nonvolatile', "Is non-volatile: ", yn),
-                    ('is_eeprom',      "Is EEPROM:       ", yn)
+                    ('is_eeprom',      "Is EEPROM:       ", yn),
+                    ('power_on_settle_micros', "Power-on settle: ", us),
+                    ('strobe_micros',  "Strobe time:     ", us),
+                    ('uses_data_protection', "Data protection: ", yn)
                 )
                 for attr, label, transformer in rows:
                     attr = getattr(framune.chip, attr)
                     value = transformer(attr) if attr is not None else "Unknown"
                     print("{}{}".format(label, value))
+                print("Max size:        {} ({} address lines)".format(
+                    format_size(2 ** address_width), address_width))
             
             return 0
         
+        if arguments.command == 'stats':
+            stats = framune.get_stats()
+            if stats is None:
+                print("This F-Ramune was built without performance counters.",
+                      file=sys.stderr)
+                return 1
+            if arguments.json:
+                print(json.dumps(stats, indent=4))
+            else:
+                labels = dict(STATS_COUNTERS)
+                for name, value in stats.items():
+                    label = labels.get(name, "{}: ".format(name).ljust(24))
+                    if name.startswith('micros_'):
+                        value = "{:.3f} ms".format(value / 1000)
+                    elif name.startswith('stack_bytes_'):
+                        value = format_size(value)
+                    print("{}{}".format(label, value))
+            
+            return 0
+
+        if arguments.command == 'diagnose':
+            address_width = 0
+            if arguments.size:
+                address_width = (arguments.size - 1).bit_length()
+            result = framune.diagnose(address_width)
+            works = result['addresses_tested'] and not any(result[k] for k in (
+                'data_stuck_low', 'data_stuck_high', 'data_shorted',
+                'address_stuck', 'address_shorted'
+            ))
+            if arguments.json:
+                print(json.dumps(result, indent=4))
+                return 0 if works else 1
+
+            names = lambda prefix, lines: ", ".join("{}{}".format(prefix, i) for i in lines)
+            problems = []
+            if len(result['data_stuck_high']) == 8:
+                problems.append("All data lines read high. Is there a chip in the socket?")
+            elif result['data_stuck_high']:
+                problems.append("Stuck high or not connected: {}".format(
+                    names("D", result['data_stuck_high'])))
+            if result['data_stuck_low']:
+                problems.append("Stuck low: {}".format(names("D", result['data_stuck_low'])))
+            if result['data_shorted']:
+                problems.append("Shorted together: {}".format(names("D", result['data_shorted'])))
+            if not result['addresses_tested']:
+                problems.append("The address lines can't be checked until the data lines work.")
+            if result['address_stuck']:
+                problems.append("Stuck or not connected: {}".format(
+                    names("A", result['address_stuck'])))
+                # A whole shift register's worth of lines is likely to be
+                # the shift register itself (or its wiring).
+                width = result['address_width']
+                for first in range(0, width, SHIFT_REGISTER_BITS):
+                    chunk = set(range(first, min(first + SHIFT_REGISTER_BITS, width)))
+                    if chunk <= set(result['address_stuck']):
+                        problems.append("  (That's all of shift register {}'s lines - "
+                                        "check it and its wiring.)".format(
+                                            first // SHIFT_REGISTER_BITS + 1))
+            if result['address_shorted']:
+                problems.append("Shorted together: {}".format(
+                    names("A", result['address_shorted'])))
+
+            if not works:
+                for problem in problems:
+                    print(problem)
+                return 1
+            print("All 8 data lines and {} address lines work!".format(
+                result['address_width']))
+            return 0
+
         if framune.chip.is_operational == False:
             print("It appears that the connected F-Ramune is not connected "
                   "to an operational memory chip.", file=sys.stderr)
@@ -434,6 +1186,10 @@ def main(*argv):
                 print("Could not determine size of memory!", file=sys.stderr)
                 return 1
             data = framune.read(arguments.address, size)
+            if len(data) < size:
+                print("Only {} could be read - the rest is past the end of the chip "
+                      "(or of what the F-Ramune can address).".format(format_size(len(data))),
+                      file=sys.stderr)
             if arguments.o:
                 with open(arguments.o, 'wb') as f:
                     f.write(data)
@@ -447,6 +1203,141 @@ def main(*argv):
             
             return 0
         
+        if arguments.command == 'verify':
+            if arguments.i:
+                with open(arguments.i, 'rb') as f:
+                    data = f.read()
+            else:
+                data = sys.stdin.buffer.read()
+            if arguments.size:
+                data = data[:arguments.size]
+            length, digest = framune.get_digest(arguments.address, len(data))
+            if length < len(data):
+                print("Only {} of the file fits on the chip (or in what the F-Ramune "
+                      "can address), so it can't match.".format(format_size(length)),
+                      file=sys.stderr)
+                return 1
+            if digest != crc32(data):
+                print("The chip doesn't match!", file=sys.stderr)
+                return 1
+            if sys.stdout.isatty():
+                print("The chip matches ({})!".format(format_size(length)))
+            return 0
+
+        if arguments.command == 'sync':
+            path = arguments.i or arguments.o
+            if arguments.i or os.path.exists(path):
+                with open(path, 'rb') as f:
+                    data = bytearray(f.read())
+            else:
+                data = bytearray()
+            if arguments.o:
+                # The file ends up as big as asked, or as the chip.
+                size = arguments.size if arguments.size is not None else framune.chip.size
+                if size is None and not data:
+                    print("Could not determine size of memory!", file=sys.stderr)
+                    return 1
+                if size is not None:
+                    data = data[:size] + bytearray(max(0, size - len(data)))
+            elif arguments.size:
+                data = data[:arguments.size]
+
+            stretches = framune.differing_blocks(arguments.address, bytes(data),
+                                                 arguments.block_size)
+            transferred = 0
+            for offset, length in stretches:
+                if arguments.i:
+                    written = framune.write(arguments.address + offset,
+                                            bytes(data[offset:offset + length]))
+                else:
+                    block = framune.read(arguments.address + offset, length)
+                    data[offset:offset + len(block)] = block
+                    written = len(block)
+                transferred += written
+                if written < length:
+                    print("Only got as far as 0x{:X} - the rest is past the end of the chip "
+                          "(or of what the F-Ramune can address).".format(
+                              arguments.address + offset + written),
+                          file=sys.stderr)
+                    break
+            if arguments.o:
+                with open(path, 'wb') as f:
+                    f.write(data)
+
+            if sys.stdout.isatty():
+                print("{} {} of {} ({} differing block(s)).".format(
+                    "Wrote" if arguments.i else "Read", format_size(transferred),
+                    format_size(len(data)),
+                    sum(-(-length // arguments.block_size) for offset, length in stretches)))
+            else:
+                print(transferred)
+
+            return 0
+
+        if arguments.command in ('fill', 'erase'):
+            size = arguments.size if arguments.size is not None else framune.chip.size
+            if size is None:
+                print("Could not determine size of memory!", file=sys.stderr)
+                return 1
+            if arguments.command == 'erase':
+                filled = framune.fill(arguments.address, size)
+            else:
+                filled = framune.fill(arguments.address, size,
+                                      FILL_PATTERNS[arguments.pattern], arguments.seed)
+            if filled < size:
+                print("Only {} could be filled - the rest is past the end of the chip "
+                      "(or of what the F-Ramune can address).".format(format_size(filled)),
+                      file=sys.stderr)
+            if sys.stdout.isatty():
+                print("{} {}!".format("Erased" if arguments.command == 'erase' else "Filled",
+                                      format_size(filled)))
+            else:
+                print(filled)
+
+            return 0
+
+        if arguments.command == 'test':
+            size = arguments.size if arguments.size is not None else framune.chip.size
+            if size is None:
+                print("Could not determine size of memory!", file=sys.stderr)
+                return 1
+            result = framune.test(arguments.address, size,
+                                  MARCH_ALGORITHMS[arguments.algorithm])
+            if arguments.json:
+                print(json.dumps(result, indent=4))
+            else:
+                print("Tested {} for {}.".format(format_size(result['size']),
+                                                ", ".join(result['detects'])))
+                if result['passed']:
+                    print("All cells work!")
+                else:
+                    if result['mismatches']:
+                        print("{} read(s) came back wrong, the first at 0x{:X}.".format(
+                            result['mismatches'], result['first_mismatch_address']))
+                    if result['failed_elements']:
+                        print("Faults found in element(s) {} (somewhere).".format(
+                            ", ".join(str(e) for e in result['failed_elements'])))
+
+            return 0 if result['passed'] else 1
+
+        if arguments.command == 'retention':
+            num_samples, points = framune.measure_retention()
+            if arguments.json:
+                print(json.dumps(OrderedDict((
+                    ('cells_sampled', num_samples),
+                    ('curve', [OrderedDict((('micros_off', micros), ('cells_lost', lost)))
+                               for micros, lost in points])
+                )), indent=4))
+            else:
+                print("Off for      Cells lost (of {})".format(num_samples))
+                for micros, lost in points:
+                    bar = "#" * round(40 * lost / num_samples)
+                    print("{:>9.3f} ms {:>5} {}".format(micros / 1000, lost, bar))
+                if not any(lost for micros, lost in points):
+                    print("Didn't lose a thing. Looks non-volatile!")
+
+            return 0
+
         if arguments.command == 'write':
             if arguments.i:
                 with open(arguments.i, 'rb') as f:
@@ -455,9 +1346,21 @@ def main(*argv):
                 data = sys.stdin.buffer.read()
             if arguments.size:
                 data = data[:arguments.size]
-            written = framune.write(arguments.address, data)
+            changed = None
+            if arguments.diff:
+                written, changed = framune.write_changes(arguments.address, data)
+            else:
+                written = framune.write(arguments.address, data)
+            if written < len(data):
+                print("Only {} could be written - the rest is past the end of the chip "
+                      "(or of what the F-Ramune can address).".format(format_size(written)),
+                      file=sys.stderr)
             if sys.stdout.isatty():
-                print("Wrote {}!".format(format_size(written)))
+                if changed is None:
+                    print("Wrote {}!".format(format_size(written)))
+                else:
+                    print("Wrote {}! ({} changed)".format(format_size(written),
+                                                         format_size(changed)))
             else:
                 print(written)
             
@@ -0,0 +1,1190 @@
+// Benchmarks for the firmware's hot paths, run on the simulated board.
+// For each operation, this prints how much work it made the hardware do -
+// port writes, SPI bytes and transactions, CE strobes, and so on. The counts
+// are exact and repeatable, so they can be compared between commits.
+// Every operation's result is checked against the simulated chip too, and
+// if any of them are wrong, the exit status is non-zero.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <Arduino.h>
+#include <SPI.h>
+#include <CRC32.h>
+#include "simulator.hpp"
+#include "channelio.hpp"
+#include "framecompression.hpp"
+#include "memorychip.hpp"
+#include "serialinterface.hpp"
+
+// The Nano layout from software.ino.
+typedef Output_SpiShiftRegister<uint16_t, StaticPin<10>> NanoAddressChannel;
+typedef InputOutput_PinBus<A0, A1, A2, 3, 4, 5, 6, 7> NanoDataChannel;
+typedef MemoryChipStaticPins<A4, A5, 2, A3> NanoControlPins;
+typedef BasicMemoryChip<NanoAddressChannel, NanoDataChannel, NanoControlPins>
+    NanoMemoryChip;
+
+NanoAddressChannel NANO_ADDRESS_CHANNEL(20000000, SPI_MODE0, StaticPin<10>());
+NanoDataChannel NANO_DATA_CHANNEL(INPUT_PULLUP);
+NanoMemoryChip NANO_MEMORY_CHIP(&NANO_ADDRESS_CHANNEL, &NANO_DATA_CHANNEL,
+                                NanoControlPins(), HIGH);
+
+// The Nano layout with a third 74HC595 on the chain, for chips over 64 KiB.
+typedef Output_SpiShiftRegister<uint24_t, StaticPin<10>> WideAddressChannel;
+typedef BasicMemoryChip<WideAddressChannel, NanoDataChannel, NanoControlPins>
+    WideMemoryChip;
+
+WideAddressChannel WIDE_ADDRESS_CHANNEL(20000000, SPI_MODE0, StaticPin<10>());
+WideMemoryChip WIDE_MEMORY_CHIP(&WIDE_ADDRESS_CHANNEL, &NANO_DATA_CHANNEL,
+                                NanoControlPins(), HIGH);
+
+// The same wiring, set up the runtime-polymorphic way.
+Output_SpiShiftRegister<uint16_t> RUNTIME_ADDRESS_CHANNEL(20000000, SPI_MODE0, 10);
+InputOutput_Port RUNTIME_DATA_CHANNEL_PORT_1(INPUT_PULLUP, &PIND, &PORTD, &DDRD, 3, 3, 5);
+InputOutput_Port RUNTIME_DATA_CHANNEL_PORT_2(INPUT_PULLUP, &PINC, &PORTC, &DDRC, 0, 0, 3);
+InputOutput_Port* RUNTIME_DATA_CHANNEL_PORTS[] = {
+    &RUNTIME_DATA_CHANNEL_PORT_1,
+    &RUNTIME_DATA_CHANNEL_PORT_2
+};
+InputOutputChannelSet<uint8_t, InputOutput_Port> RUNTIME_DATA_CHANNEL(
+    2, RUNTIME_DATA_CHANNEL_PORTS
+);
+MemoryChip RUNTIME_MEMORY_CHIP(&RUNTIME_ADDRESS_CHANNEL, &RUNTIME_DATA_CHANNEL,
+                               A4, A5, 2, A3, HIGH);
+
+static int failures = 0;
+
+static void check(bool condition, const char* description)
+{
+    if (!condition) {
+        printf("    FAILED: %s\n", description);
+        failures++;
+    }
+}
+
+static void printHeader(const char* title)
+{
+    printf("\n%s\n", title);
+    printf("%-30s %10s %9s %9s %8s %9s %9s %9s %6s\n",
+           "operation", "port wr.", "mode sw.", "SPI B", "SPI tr.",
+           "strobes", "chip rd.", "chip wr.", "power");
+}
+
+static void report(const char* operation)
+{
+    const SimulatorCounters& c = SIMULATOR.counters;
+    printf("%-30s %10lu %9lu %9lu %8lu %9lu %9lu %9lu %6lu\n",
+           operation, c.portWrites, c.busDirectionWrites, c.spiBytes,
+           c.spiTransactions, c.strobes, c.chipReads, c.chipWrites,
+           c.powerCycles);
+    check(c.busContentions == 0, "chip and MCU both drove the data bus");
+}
+
+static std::vector<uint8_t> noise(size_t length, uint32_t seed)
+{
+    std::vector<uint8_t> data(length);
+    for (uint8_t& n : data) {
+        seed = seed * 1664525 + 1013904223;
+        n = static_cast<uint8_t>(seed >> 24);
+    }
+    return data;
+}
+
+static uint32_t readUint32(const uint8_t* bytes)
+{
+    return static_cast<uint32_t>(bytes[0]) << 24 |
+           static_cast<uint32_t>(bytes[1]) << 16 |
+           static_cast<uint32_t>(bytes[2]) << 8 |
+           static_cast<uint32_t>(bytes[3]);
+}
+
+// The host's side of the frames that reads and writes send the data in
+// (see _sendFrame in serialinterface.cpp).
+#define FRAME_START 0xFA
+#define FRAME_ACK   0xFB
+#define FRAME_NAK   0xFC
+#define FRAME_END   0xFD
+#define FRAME_FIN   0xFE
+#define FRAME_LENGTH (3 + FRAMUNE_FRAME_SIZE + 4)
+#define FRAME_RAW        0
+#define FRAME_COMPRESSED 1
+// What READ, WRITE and WRITE_CHANGED answer with before the frames: the
+// command's echo, the size, the window and the encoding.
+#define TRANSFER_REPLY_LENGTH (1 + 4 + 1 + 1)
+
+// Feeds the start of a READ, WRITE or WRITE_CHANGED.
+static void feedTransfer(SimulatedSerial& serial, uint8_t command, uint32_t address,
+                         uint32_t size, uint8_t encoding = FRAME_RAW)
+{
+    serial.feed(command);
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feedUint32(address);
+    serial.feedUint32(size);
+    serial.feed(encoding);
+}
+
+static void feedControl(SimulatedSerial& serial, uint8_t marker, uint8_t sequence)
+{
+    serial.feed(marker);
+    serial.feed(sequence);
+    serial.feed(static_cast<uint8_t>(~sequence));
+}
+
+// Feeds the frames for writing length bytes of data at address, and the
+// FIN for after the END. The frame at damagedFrame goes in with a bit
+// flipped first, for the F-Ramune to NAK.
+static void feedFrames(SimulatedSerial& serial, uint32_t address,
+                       const uint8_t* data, uint32_t length,
+                       uint32_t damagedFrame = UINT32_MAX, bool isCompressing = false)
+{
+    uint32_t frameAddress = address - address % FRAMUNE_FRAME_SIZE;
+    uint32_t index = 0;
+    for (; frameAddress < address + length; index++, frameAddress += FRAMUNE_FRAME_SIZE) {
+        uint8_t frameData[FRAMUNE_FRAME_SIZE];
+        for (uint32_t i = 0; i < FRAMUNE_FRAME_SIZE; i++) {
+            uint32_t a = frameAddress + i;
+            frameData[i] = a >= address && a < address + length ? data[a - address] : 0;
+        }
+        uint8_t frame[4 + FRAMUNE_FRAME_SIZE + 4] = {FRAME_START, static_cast<uint8_t>(index),
+                                                     static_cast<uint8_t>(~index)};
+        uint8_t frameLength = 3;
+        if (isCompressing) {
+            uint8_t payloadLength = compressFrame(frameData, FRAMUNE_FRAME_SIZE, frame + 4);
+            if (payloadLength == FRAMUNE_FRAME_SIZE) {
+                memcpy(frame + 4, frameData, FRAMUNE_FRAME_SIZE);
+            }
+            frame[frameLength++] = payloadLength;
+            frameLength += payloadLength;
+        } else {
+            memcpy(frame + 3, frameData, FRAMUNE_FRAME_SIZE);
+            frameLength += FRAMUNE_FRAME_SIZE;
+        }
+        CRC32 crc;
+        crc.update(frame[1]);
+        crc.update(frameData, FRAMUNE_FRAME_SIZE);
+        uint32_t n = crc.finalize();
+        for (int i = 0; i < 4; i++) {
+            frame[frameLength++] = n >> (24 - 8 * i);
+        }
+        if (index == damagedFrame) {
+            frame[5] ^= 0x04;
+            serial.feed(frame, frameLength);
+            frame[5] ^= 0x04;
+        }
+        serial.feed(frame, frameLength);
+    }
+    feedControl(serial, FRAME_FIN, index);
+}
+
+// Skips the ACKs (and NAKs) that a write answers frames with, and the END
+// after them. Returns where the rest of the reply starts, or 0 if it's not
+// all there.
+static size_t skipFrameReplies(const std::vector<uint8_t>& output, size_t offset,
+                               uint32_t* naks = NULL)
+{
+    while (offset + 3 <= output.size() &&
+           static_cast<uint8_t>(~output[offset + 1]) == output[offset + 2]) {
+        if (output[offset] == FRAME_END) {
+            return offset + 3;
+        }
+        if (output[offset] == FRAME_NAK && naks) {
+            (*naks)++;
+        } else if (output[offset] != FRAME_ACK) {
+            return 0;
+        }
+        offset += 3;
+    }
+    return 0;
+}
+
+// Runs a READ, ACKing the frames as they come in - except for the one at
+// damagedFrame, which gets NAKed the first time. Returns false if anything
+// about the reply's off.
+template <class SerialInterfaceType>
+static bool runRead(SerialInterfaceType& serialInterface, SimulatedSerial& serial,
+                    uint32_t address, uint32_t size, std::vector<uint8_t>& data,
+                    uint32_t damagedFrame = UINT32_MAX, uint8_t encoding = FRAME_RAW)
+{
+    serial.clear();
+    feedTransfer(serial, 0x02, address, size, encoding); // READ
+    bool isBusy = serialInterface.update();
+    if (serial.output.size() < TRANSFER_REPLY_LENGTH ||
+        serial.output[TRANSFER_REPLY_LENGTH - 1] != encoding) {
+        return false;
+    }
+    size = readUint32(&serial.output[1]);
+    data.assign(size, 0);
+    uint32_t firstFrameAddress = address - address % FRAMUNE_FRAME_SIZE;
+    std::vector<bool> isReceived(size ? (address + size - firstFrameAddress +
+                                         FRAMUNE_FRAME_SIZE - 1) / FRAMUNE_FRAME_SIZE : 0);
+    uint32_t firstMissing = 0;
+    bool isEnded = false;
+    size_t offset = TRANSFER_REPLY_LENGTH;
+    while (true) {
+        while (offset + 3 <= serial.output.size()) {
+            const uint8_t* message = &serial.output[offset];
+            if (message[0] == FRAME_END) {
+                feedControl(serial, FRAME_FIN, message[1]);
+                isEnded = true;
+                offset += 3;
+                continue;
+            }
+            if (message[0] != FRAME_START || static_cast<uint8_t>(~message[1]) != message[2]) {
+                return false;
+            }
+            uint8_t frameData[FRAMUNE_FRAME_SIZE];
+            size_t frameLength = FRAME_LENGTH;
+            if (encoding == FRAME_COMPRESSED) {
+                uint8_t payloadLength = message[3];
+                frameLength = 4 + payloadLength + 4;
+                if (offset + frameLength > serial.output.size()) {return false;}
+                if (payloadLength == FRAMUNE_FRAME_SIZE) {
+                    memcpy(frameData, message + 4, FRAMUNE_FRAME_SIZE);
+                } else if (!expandFrame(message + 4, payloadLength, frameData,
+                                        FRAMUNE_FRAME_SIZE)) {
+                    return false;
+                }
+            } else {
+                if (offset + frameLength > serial.output.size()) {return false;}
+                memcpy(frameData, message + 3, FRAMUNE_FRAME_SIZE);
+            }
+            CRC32 crc;
+            crc.update(message[1]);
+            crc.update(frameData, FRAMUNE_FRAME_SIZE);
+            if (crc.finalize() != readUint32(message + frameLength - 4)) {return false;}
+            uint32_t index = firstMissing + static_cast<uint8_t>(message[1] - firstMissing);
+            if (index >= isReceived.size()) {return false;}
+            if (index == damagedFrame) {
+                damagedFrame = UINT32_MAX;
+                feedControl(serial, FRAME_NAK, message[1]);
+            } else {
+                uint32_t frameAddress = firstFrameAddress + index * FRAMUNE_FRAME_SIZE;
+                for (uint32_t i = 0; i < FRAMUNE_FRAME_SIZE; i++) {
+                    uint32_t a = frameAddress + i;
+                    if (a >= address && a < address + size) {
+                        data[a - address] = frameData[i];
+                    }
+                }
+                isReceived[index] = true;
+                while (firstMissing < isReceived.size() && isReceived[firstMissing]) {
+                    firstMissing++;
+                }
+                feedControl(serial, FRAME_ACK, message[1]);
+            }
+            offset += frameLength;
+        }
+        if (!isBusy) {break;}
+        isBusy = serialInterface.update();
+    }
+    return isEnded && firstMissing == isReceived.size() && offset == serial.output.size();
+}
+
+template <class MemoryChipType>
+static void startOver(MemoryChipType& chip, const SimulatedChip& simulatedChip,
+                      const SimulatorWiring& wiring = SimulatorWiring())
+{
+    SIMULATOR.reset(wiring, simulatedChip);
+    chip.initPins();
+    chip.powerOn();
+    MemoryChipKnownProperties knownProperties = {
+        false, false, false, false, false, false, false
+    };
+    MemoryChipProperties properties = {
+        false, 0, false, false, MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS, 0, false
+    };
+    chip.setProperties(&knownProperties, &properties);
+}
+
+template <class MemoryChipType>
+static void benchmarkChip(const char* title, MemoryChipType& chip)
+{
+    printHeader(title);
+    SimulatedChip simulatedChip;
+    startOver(chip, simulatedChip);
+    uint32_t size = SIMULATOR.size();
+    uint8_t* memory = SIMULATOR.memory();
+    char description[64];
+
+    chip.switchToReadMode();
+    SIMULATOR.resetCounters();
+    uint8_t n = chip.readByte(0x1234);
+    report("readByte");
+    check(n == memory[0x1234], "readByte read the wrong byte");
+
+    chip.switchToWriteMode();
+    SIMULATOR.resetCounters();
+    chip.writeByte(0x4321, 0x5A);
+    report("writeByte");
+    check(memory[0x4321] == 0x5A, "writeByte wrote the wrong byte");
+
+    chip.switchToReadMode();
+    SIMULATOR.resetCounters();
+    uint8_t verified;
+    n = chip.readModifyWriteByte(0x4321, 0xF0, 0x0F, &verified);
+    report("readModifyWriteByte");
+    check(n == 0x5A, "readModifyWriteByte read the wrong byte");
+    check(memory[0x4321] == 0x5F && verified == 0x5F,
+          "readModifyWriteByte wrote the wrong byte");
+    chip.switchToWriteMode();
+
+    SIMULATOR.resetCounters();
+    chip.switchToReadMode();
+    chip.switchToWriteMode();
+    report("switchToRead/WriteMode");
+
+    std::vector<uint8_t> buffer(size);
+    chip.switchToReadMode();
+    SIMULATOR.resetCounters();
+    chip.readBytes(0, buffer.data(), size);
+    snprintf(description, sizeof(description), "readBytes (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(memcmp(buffer.data(), memory, size) == 0,
+          "readBytes read the wrong bytes");
+
+    std::vector<uint8_t> data = noise(size, 1);
+    chip.switchToWriteMode();
+    SIMULATOR.resetCounters();
+    chip.writeBytes(0, data.data(), size);
+    snprintf(description, sizeof(description), "writeBytes (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(memcmp(data.data(), memory, size) == 0,
+          "writeBytes wrote the wrong bytes");
+
+    SIMULATOR.resetCounters();
+    bool addressesWork = chip.addressesWorkBetween(0, size);
+    report("addressesWorkBetween (all)");
+    check(addressesWork, "addressesWorkBetween failed on a working chip");
+    check(memcmp(data.data(), memory, size) == 0,
+          "addressesWorkBetween didn't put the data back");
+
+    SIMULATOR.resetCounters();
+    chip.analyze();
+    report("analyze");
+    MemoryChipKnownProperties knownProperties;
+    MemoryChipProperties properties;
+    chip.getProperties(&knownProperties, &properties);
+    check(properties.isOperational, "analyze: not operational");
+    check(properties.size == size, "analyze: wrong size");
+    check(properties.isNonVolatile, "analyze: FRAM came out volatile");
+    check(memcmp(data.data(), memory, size) == 0,
+          "analyze didn't put the data back");
+
+    SimulatedSerial serial;
+    BasicSerialInterface<MemoryChipType> serialInterface(&serial, &chip);
+
+    std::vector<uint8_t> received;
+    SIMULATOR.resetCounters();
+    bool isReadOk = runRead(serialInterface, serial, 0, size, received);
+    snprintf(description, sizeof(description), "serial read (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(isReadOk, "serial read sent a broken reply");
+    check(received.size() == size && memcmp(received.data(), memory, size) == 0,
+          "serial read sent the wrong data");
+
+    // A frame that gets NAKed, and a read that doesn't start or end on a
+    // frame boundary. (runRead only gets all the frames if that one's sent
+    // again.)
+#if STATS_ENABLED
+    STATS[STATS_FRAMES_RESENT] = 0;
+#endif
+    isReadOk = runRead(serialInterface, serial, 100, 1000, received, 3);
+    check(isReadOk && received.size() == 1000 &&
+          memcmp(received.data(), memory + 100, 1000) == 0,
+          "serial read with a NAK sent the wrong data");
+#if STATS_ENABLED
+    check(STATS[STATS_FRAMES_RESENT] == 1, "serial read didn't count the resent frame");
+#endif
+
+    serial.clear();
+    data = noise(size, 2);
+    feedTransfer(serial, 0x03, 0, size); // WRITE
+    feedFrames(serial, 0, data.data(), size);
+    SIMULATOR.resetCounters();
+    // With all the frames there at once, the first go takes in as many as
+    // there are slots for, and leaves the rest waiting, unACKed.
+    serialInterface.update();
+    serialInterface.update();
+    size_t acksBeforeFirstWrite = (serial.output.size() - TRANSFER_REPLY_LENGTH) / 3;
+    while (serialInterface.update()) {}
+    snprintf(description, sizeof(description), "serial write (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(acksBeforeFirstWrite == FRAMUNE_FRAME_SLOTS,
+          "serial write didn't stop taking in frames when its slots were full");
+    check(memcmp(data.data(), memory, size) == 0,
+          "serial write wrote the wrong data");
+    size_t resultsAt = skipFrameReplies(serial.output, TRANSFER_REPLY_LENGTH);
+    check(resultsAt && serial.output.size() == resultsAt + 4 + 1,
+          "serial write sent the wrong number of bytes");
+    if (resultsAt && serial.output.size() == resultsAt + 4 + 1) {
+        check(readUint32(&serial.output[resultsAt]) ==
+              CRC32::calculate(data.data(), size),
+              "serial write sent the wrong CRC");
+        check(serial.output[resultsAt + 4] == 0, "serial write sent an error");
+    }
+
+    // A damaged frame, which gets NAKed and sent again.
+    serial.clear();
+    std::vector<uint8_t> rewritten = noise(1000, 5);
+    feedTransfer(serial, 0x03, 100, 1000); // WRITE
+    feedFrames(serial, 100, rewritten.data(), 1000, 2);
+    while (serialInterface.update()) {}
+    uint32_t naks = 0;
+    resultsAt = skipFrameReplies(serial.output, TRANSFER_REPLY_LENGTH, &naks);
+    check(memcmp(rewritten.data(), memory + 100, 1000) == 0 && naks == 1 &&
+          resultsAt && serial.output.size() == resultsAt + 4 + 1 &&
+          serial.output[resultsAt + 4] == 0,
+          "serial write with a damaged frame went wrong");
+
+    // Compressed, with the data mostly blank, like a save file often is.
+    // A damaged frame has to get sent again either way.
+    std::vector<uint8_t> sparse(size, 0xFF);
+    for (uint32_t address = 0; address < size; address += 1024) {
+        memcpy(&sparse[address], "SAVE DATA v1.0", 14);
+        sparse[address + 100] = address >> 10;
+    }
+    memcpy(memory, sparse.data(), size);
+    SIMULATOR.resetCounters();
+    isReadOk = runRead(serialInterface, serial, 0, size, received, 3, FRAME_COMPRESSED);
+    snprintf(description, sizeof(description), "compressed read (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(isReadOk && received == sparse, "compressed serial read sent the wrong data");
+    check(serial.output.size() < size / 4,
+          "compressed serial read didn't compress blank data much");
+
+    for (uint32_t address = 0; address < size; address += 1024) {
+        sparse[address + 200] = ~address >> 10;
+    }
+    serial.clear();
+    feedTransfer(serial, 0x03, 0, size, FRAME_COMPRESSED); // WRITE
+    feedFrames(serial, 0, sparse.data(), size, 5, true);
+    size_t compressedLength = serial.available();
+    SIMULATOR.resetCounters();
+    while (serialInterface.update()) {}
+    snprintf(description, sizeof(description), "compressed write (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(memcmp(sparse.data(), memory, size) == 0,
+          "compressed serial write wrote the wrong data");
+    check(compressedLength < size / 4,
+          "compressed serial write didn't compress blank data much");
+    naks = 0;
+    resultsAt = skipFrameReplies(serial.output, TRANSFER_REPLY_LENGTH, &naks);
+    check(serial.output[TRANSFER_REPLY_LENGTH - 1] == FRAME_COMPRESSED && naks == 1 &&
+          resultsAt && serial.output.size() == resultsAt + 4 + 1 &&
+          readUint32(&serial.output[resultsAt]) == CRC32::calculate(sparse.data(), size),
+          "compressed serial write went wrong");
+    uint8_t* scratchBuffer = borrowScratchBuffer();
+    check(scratchBuffer, "serial write didn't give back the scratch buffer");
+    returnScratchBuffer();
+
+    // Filling on the F-Ramune, with nothing but the pattern coming in.
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x0A)); // FILL
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feed(static_cast<uint8_t>(FILL_LFSR));
+    serial.feedUint32(0x1234);
+    serial.feedUint32(0);
+    serial.feedUint32(size);
+    SIMULATOR.resetCounters();
+    while (serialInterface.update()) {}
+    snprintf(description, sizeof(description), "serial fill (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    FillPattern pattern;
+    initFillPattern(FILL_LFSR, 0x1234, 0, &pattern);
+    fillPatternBytes(&pattern, data.data(), size);
+    // The same as framune.py's, or its CRC won't match.
+    check(data[0] == 0x1A && data[1] == 0x8D && data[2] == 0x45 && data[3] == 0x21,
+          "fill: the LFSR pattern isn't what framune.py expects");
+    check(memcmp(data.data(), memory, size) == 0, "serial fill filled in the wrong data");
+    check(serial.output.size() == 1 + 1 + 4 + 1 + 4,
+          "serial fill sent the wrong number of bytes");
+    if (serial.output.size() == 1 + 1 + 4 + 1 + 4) {
+        check(serial.output[1] == 1 && readUint32(&serial.output[2]) == size &&
+              serial.output[6] == 1,
+              "serial fill didn't fill everything");
+        check(readUint32(&serial.output[7]) == CRC32::calculate(data.data(), size),
+              "serial fill sent the wrong CRC");
+    }
+
+    // A block size that doesn't go into the chip's, so the last one's short.
+    const uint16_t blockSize = 1000;
+    const uint32_t numBlocks = (size + blockSize - 1) / blockSize;
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x0B)); // GET_BLOCK_CHECKSUMS
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feedUint16(blockSize);
+    serial.feedUint32(0);
+    serial.feedUint32(size);
+    SIMULATOR.resetCounters();
+    while (serialInterface.update()) {}
+    snprintf(description, sizeof(description), "serial block CRCs (%lu B)",
+             static_cast<unsigned long>(size));
+    report(description);
+    check(serial.output.size() == 1 + 1 + 4 + 4 * numBlocks,
+          "serial block CRCs sent the wrong number of bytes");
+    if (serial.output.size() == 1 + 1 + 4 + 4 * numBlocks) {
+        bool allMatch = true;
+        for (uint32_t i = 0; i < numBlocks; i++) {
+            uint32_t length = size - i * blockSize < blockSize ?
+                              size - i * blockSize : blockSize;
+            allMatch = allMatch && readUint32(&serial.output[6 + 4 * i]) ==
+                                   CRC32::calculate(memory + i * blockSize, length);
+        }
+        check(allMatch, "serial block CRCs sent the wrong CRCs");
+    }
+
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x0C)); // GET_DIGEST
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feedUint32(0x100);
+    serial.feedUint32(size);
+    SIMULATOR.resetCounters();
+    while (serialInterface.update()) {}
+    snprintf(description, sizeof(description), "serial digest (%lu B)",
+             static_cast<unsigned long>(size - 0x100));
+    report(description);
+    check(serial.output.size() == 1 + 4 + 4 && readUint32(&serial.output[1]) == size - 0x100,
+          "serial digest didn't stop at the end of the chip");
+    if (serial.output.size() == 1 + 4 + 4) {
+        check(readUint32(&serial.output[5]) == CRC32::calculate(memory + 0x100, size - 0x100),
+              "serial digest sent the wrong CRC");
+    }
+
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x04)); // GET_AND_RESET_STATS
+    serial.feed(static_cast<uint8_t>(0x00));
+    while (serialInterface.update()) {}
+#if STATS_ENABLED
+    check(serial.output.size() == 1 + 2 + 4 * STATS_NUM_COUNTERS,
+          "stats: wrong number of bytes sent");
+    if (serial.output.size() == 1 + 2 + 4 * STATS_NUM_COUNTERS) {
+        check(readUint32(&serial.output[3 + 4 * STATS_BYTES_WRITTEN]) >= size,
+              "stats: the serial write's bytes weren't counted");
+    }
+    check(STATS[STATS_BYTES_WRITTEN] == 0, "stats: not reset");
+#else
+    // Just that there aren't any.
+    check(serial.output.size() == 1 + 2 && serial.output[1] == 0 && serial.output[2] == 0,
+          "stats: sent counters that were compiled out");
+#endif
+
+    // A 16-bit address channel can't go past 64 KiB, whatever's asked.
+    serial.clear();
+    MemoryChipKnownProperties unknownProperties = {
+        false, false, false, false, false, false, false
+    };
+    chip.setProperties(&unknownProperties, &properties);
+    isReadOk = runRead(serialInterface, serial, 0x10000, 0x100, received);
+    check(isReadOk && received.empty(),
+          "serial read went past what the address channel can reach");
+    chip.setProperties(&knownProperties, &properties);
+}
+
+template <class MemoryChipType>
+static void benchmarkMarchTests(const char* title, MemoryChipType& chip)
+{
+    printHeader(title);
+    SimulatedChip simulatedChip;
+    startOver(chip, simulatedChip);
+    uint32_t size = SIMULATOR.size();
+    uint8_t* memory = SIMULATOR.memory();
+    std::vector<uint8_t> original(memory, memory + size);
+    const char* names[MARCH_NUM_ALGORITHMS] = {"MATS+", "March C-", "March SS"};
+    char description[64];
+
+    for (uint8_t id = 0; id < MARCH_NUM_ALGORITHMS; id++) {
+        MarchAlgorithm algorithm;
+        getMarchAlgorithm(id, &algorithm);
+        MarchTestResult result;
+        SIMULATOR.resetCounters();
+        chip.runMarchTest(algorithm, 0, size, &result, NULL);
+        snprintf(description, sizeof(description), "runMarchTest (%s)", names[id]);
+        report(description);
+        check(result.passed, "march test failed on a working chip");
+        check(memcmp(original.data(), memory, size) == 0,
+              "march test didn't leave the data as it was");
+    }
+
+    // And now, with something for them to find.
+    SimulatedChip stuckBits;
+    stuckBits.stuckBitsAddress = 0x1234;
+    stuckBits.stuckBitsMask = 0x10;
+    stuckBits.stuckBitsValue = 0x10;
+    SimulatedChip stuckAddressLine;
+    stuckAddressLine.stuckLowAddressLines = 1 << 9;
+    for (uint8_t id = 0; id < MARCH_NUM_ALGORITHMS; id++) {
+        MarchAlgorithm algorithm;
+        getMarchAlgorithm(id, &algorithm);
+        MarchTestResult result;
+
+        startOver(chip, stuckBits);
+        chip.runMarchTest(algorithm, 0, size, &result, NULL);
+        check(!result.passed, "march test missed a stuck bit");
+        // Only the reads after an element's first read say where.
+        check(!result.mismatches || result.firstMismatchAddress == 0x1234,
+              "march test blamed the wrong address for a stuck bit");
+
+        startOver(chip, stuckAddressLine);
+        chip.runMarchTest(algorithm, 0, size, &result, NULL);
+        check(!result.passed, "march test missed a stuck address line");
+    }
+
+    startOver(chip, simulatedChip);
+    SimulatedSerial serial;
+    BasicSerialInterface<MemoryChipType> serialInterface(&serial, &chip);
+    serial.feed(static_cast<uint8_t>(0x05)); // RUN_MARCH_TEST
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feed(static_cast<uint8_t>(MARCH_C_MINUS));
+    serial.feedUint32(0x100);
+    serial.feedUint32(0x1000);
+    SIMULATOR.resetCounters();
+    while (serialInterface.update()) {}
+    report("serial march test (4 KiB)");
+    check(serial.output.size() == 1 + 1 + 4 + 2 + 1 + 1 + 4 + 4 + 2,
+          "serial march test sent the wrong number of bytes");
+    if (serial.output.size() == 1 + 1 + 4 + 2 + 1 + 1 + 4 + 4 + 2) {
+        check(serial.output[1] == 1, "serial march test: no March C-?");
+        check(readUint32(&serial.output[2]) == 0x1000,
+              "serial march test sent the wrong size");
+        check(serial.output[8] == 10,
+              "serial march test sent the wrong operations per cell");
+        check(serial.output[9] == 1, "serial march test failed");
+    }
+
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x05));
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feed(static_cast<uint8_t>(MARCH_NUM_ALGORITHMS));
+    serial.feedUint32(0);
+    serial.feedUint32(size);
+    while (serialInterface.update()) {}
+    check(serial.output.size() == 2 && serial.output[1] == 0,
+          "serial march test ran an algorithm that doesn't exist");
+}
+
+template <class MemoryChipType>
+static void benchmarkDiagnoseLines(const char* title, MemoryChipType& chip)
+{
+    printHeader(title);
+    MemoryChipLineDiagnosis diagnosis;
+    SimulatedChip simulatedChip;
+    startOver(chip, simulatedChip);
+    uint32_t size = SIMULATOR.size();
+    std::vector<uint8_t> original(SIMULATOR.memory(), SIMULATOR.memory() + size);
+    SIMULATOR.resetCounters();
+    bool diagnosed = chip.diagnoseLines(15, &diagnosis);
+    report("diagnoseLines (working chip)");
+    check(diagnosed, "diagnoseLines didn't run");
+    check(!diagnosis.dataStuckLow && !diagnosis.dataStuckHigh &&
+          !diagnosis.dataShorted && diagnosis.addressesTested &&
+          !diagnosis.addressStuck && !diagnosis.addressShorted,
+          "diagnoseLines found faults on a working chip");
+    check(memcmp(original.data(), SIMULATOR.memory(), size) == 0,
+          "diagnoseLines didn't leave the data as it was");
+
+    SimulatedChip openDataLine;
+    openDataLine.openDataLines = 1 << 5;
+    startOver(chip, openDataLine);
+    chip.diagnoseLines(15, &diagnosis);
+    check(diagnosis.dataStuckHigh == 1 << 5 && !diagnosis.dataStuckLow &&
+          !diagnosis.dataShorted && !diagnosis.addressesTested,
+          "diagnoseLines missed an open data line");
+
+    SimulatedChip stuckAddressLine;
+    stuckAddressLine.stuckLowAddressLines = 1 << 9;
+    startOver(chip, stuckAddressLine);
+    chip.diagnoseLines(15, &diagnosis);
+    check(diagnosis.addressStuck == 1 << 9 && !diagnosis.addressShorted,
+          "diagnoseLines missed a stuck address line");
+
+    SimulatedChip shortedAddressLines;
+    shortedAddressLines.shortedAddressLines = 1 << 3 | 1 << 4;
+    startOver(chip, shortedAddressLines);
+    chip.diagnoseLines(15, &diagnosis);
+    check(diagnosis.addressShorted == (1 << 3 | 1 << 4) && !diagnosis.addressStuck,
+          "diagnoseLines missed shorted address lines");
+
+    // The second 74HC595 in the chain doing nothing at all.
+    SimulatedChip deadShiftRegister;
+    deadShiftRegister.stuckLowAddressLines = 0xFF00;
+    startOver(chip, deadShiftRegister);
+    chip.diagnoseLines(15, &diagnosis);
+    check(diagnosis.addressStuck == 0x7F00,
+          "diagnoseLines missed a dead shift register");
+
+    startOver(chip, stuckAddressLine);
+    SimulatedSerial serial;
+    BasicSerialInterface<MemoryChipType> serialInterface(&serial, &chip);
+    serial.feed(static_cast<uint8_t>(0x06)); // DIAGNOSE_LINES
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feed(static_cast<uint8_t>(15));
+    while (serialInterface.update()) {}
+    check(serial.output.size() == 1 + 1 + 3 + 1 + 1 + 4 + 4,
+          "serial diagnose sent the wrong number of bytes");
+    if (serial.output.size() == 1 + 1 + 3 + 1 + 1 + 4 + 4) {
+        check(serial.output[1] == 1 && serial.output[5] == 15 &&
+              serial.output[6] == 1 && readUint32(&serial.output[7]) == 1 << 9,
+              "serial diagnose sent the wrong diagnosis");
+    }
+}
+
+static void benchmarkWideChip(const char* title, WideMemoryChip& chip)
+{
+    printHeader(title);
+    SimulatorWiring wiring;
+    wiring.shiftRegisterBits = 24;
+    SimulatedChip simulatedChip;
+    simulatedChip.size = 131072;
+    startOver(chip, simulatedChip, wiring);
+    uint8_t* memory = SIMULATOR.memory();
+
+    SIMULATOR.resetCounters();
+    chip.analyze();
+    report("analyze (128 KiB FRAM)");
+    MemoryChipKnownProperties knownProperties;
+    MemoryChipProperties properties;
+    chip.getProperties(&knownProperties, &properties);
+    check(properties.isOperational, "analyze: not operational");
+    check(properties.size == 131072, "analyze: wrong size");
+
+    // Right across the 64 KiB boundary.
+    std::vector<uint8_t> data = noise(0x1000, 3);
+    chip.switchToWriteMode();
+    SIMULATOR.resetCounters();
+    chip.writeBytes(0xF800, data.data(), data.size());
+    report("writeBytes (4096 B)");
+    check(memcmp(&memory[0xF800], data.data(), data.size()) == 0,
+          "writeBytes wrote the wrong bytes past 64 KiB");
+    std::vector<uint8_t> buffer(0x1000);
+    chip.switchToReadMode();
+    SIMULATOR.resetCounters();
+    chip.readBytes(0xF800, buffer.data(), buffer.size());
+    report("readBytes (4096 B)");
+    check(buffer == data, "readBytes read the wrong bytes past 64 KiB");
+
+    SimulatedSerial serial;
+    BasicSerialInterface<WideMemoryChip> serialInterface(&serial, &chip);
+    // Half of this is past the end.
+    bool isReadOk = runRead(serialInterface, serial, 0x1F000, 0x2000, buffer);
+    check(isReadOk && buffer.size() == 0x1000,
+          "serial read past 64 KiB sent the wrong number of bytes");
+    if (buffer.size() == 0x1000) {
+        check(memcmp(buffer.data(), &memory[0x1F000], 0x1000) == 0,
+              "serial read past 64 KiB sent the wrong data");
+    }
+
+    MarchTestResult result;
+    MarchAlgorithm algorithm;
+    getMarchAlgorithm(MARCH_C_MINUS, &algorithm);
+    chip.runMarchTest(algorithm, 0x1E000, 0x20000, &result, NULL);
+    check(result.passed, "march test failed past 64 KiB");
+
+    SimulatedChip stuckAddressLine = simulatedChip;
+    stuckAddressLine.stuckLowAddressLines = 1 << 16;
+    startOver(chip, stuckAddressLine, wiring);
+    MemoryChipLineDiagnosis diagnosis;
+    chip.diagnoseLines(17, &diagnosis);
+    check(diagnosis.addressStuck == static_cast<uint32_t>(1) << 16,
+          "diagnoseLines missed a stuck A16");
+}
+
+template <class MemoryChipType>
+static void benchmarkEeprom(const char* title, MemoryChipType& chip)
+{
+    printHeader(title);
+    MemoryChipKnownProperties knownProperties;
+    MemoryChipProperties properties;
+
+    // A 28C256, with its power-up write inhibit.
+    SimulatedChip eeprom;
+    eeprom.writeCycleMicros = 1000;
+    eeprom.powerOnSettleMicros = 5000;
+    startOver(chip, eeprom);
+    uint32_t size = SIMULATOR.size();
+    uint8_t* memory = SIMULATOR.memory();
+    std::vector<uint8_t> original(memory, memory + size);
+    chip.analyze();
+    report("analyze (28C256)");
+    chip.getProperties(&knownProperties, &properties);
+    check(properties.isOperational && properties.isSlow,
+          "analyze: an EEPROM didn't come out slow");
+    check(properties.size == size && properties.isNonVolatile,
+          "analyze: wrong EEPROM size or volatility");
+    check(knownProperties.usesDataProtection && !properties.usesDataProtection,
+          "analyze: an unprotected EEPROM came out protected");
+    check(memcmp(original.data(), memory, size) == 0,
+          "analyze didn't put the EEPROM's data back");
+    check(properties.powerOnSettleMicros >= 5000,
+          "analyze: an EEPROM's power-up write inhibit went unnoticed");
+
+    // Page writes make it one write cycle per 64 bytes, not per byte.
+    std::vector<uint8_t> data = noise(size, 3);
+    SIMULATOR.resetCounters();
+    unsigned long startedAt = simulatedMicros;
+    size_t written = chip.writeBytes(0, data.data(), size);
+    report("writeBytes (32768 B)");
+    check(written == size && memcmp(data.data(), memory, size) == 0,
+          "writeBytes wrote the wrong bytes to an EEPROM");
+    check(simulatedMicros - startedAt <
+          2 * (size / MEMORY_CHIP_EEPROM_PAGE_SIZE) * eeprom.writeCycleMicros,
+          "writeBytes took more than a write cycle per page");
+
+    // Not starting on a page boundary, through the serial interface. The
+    // frames line up with the pages, so it's still a write cycle per page.
+    SimulatedSerial serial;
+    BasicSerialInterface<MemoryChipType> serialInterface(&serial, &chip);
+    const uint32_t start = 100;
+    const uint32_t length = 1000;
+    const uint32_t pages = (start + length + MEMORY_CHIP_EEPROM_PAGE_SIZE - 1) /
+                           MEMORY_CHIP_EEPROM_PAGE_SIZE -
+                           start / MEMORY_CHIP_EEPROM_PAGE_SIZE;
+    data = noise(length, 4);
+    feedTransfer(serial, 0x03, start, length); // WRITE
+    feedFrames(serial, start, data.data(), length);
+    SIMULATOR.resetCounters();
+    startedAt = simulatedMicros;
+    while (serialInterface.update()) {}
+    report("serial write (1000 B)");
+    check(memcmp(data.data(), memory + start, length) == 0,
+          "serial write wrote the wrong data to an EEPROM");
+    check(simulatedMicros - startedAt < 2 * pages * eeprom.writeCycleMicros,
+          "serial write took more than a write cycle per page");
+    size_t resultsAt = skipFrameReplies(serial.output, TRANSFER_REPLY_LENGTH);
+    check(resultsAt && serial.output.size() == resultsAt + 4 + 1,
+          "serial write to an EEPROM sent the wrong number of bytes");
+    if (resultsAt && serial.output.size() == resultsAt + 4 + 1) {
+        check(readUint32(&serial.output[resultsAt]) ==
+              CRC32::calculate(data.data(), length),
+              "serial write to an EEPROM sent the wrong CRC");
+    }
+
+    // Rewriting the whole chip with an image that's only a little different,
+    // leaving the rest alone - so it's only the three pages with changes in
+    // them that take write cycles.
+    data.assign(memory, memory + size);
+    const uint32_t changes[] = {0x0010, 0x0011, 0x0030, 0x4000, 0x7FFF};
+    for (uint32_t address : changes) {
+        data[address] ^= 0x5A;
+    }
+    serial.output.clear();
+    feedTransfer(serial, 0x09, 0, size); // WRITE_CHANGED
+    feedFrames(serial, 0, data.data(), size);
+    SIMULATOR.resetCounters();
+    startedAt = simulatedMicros;
+    while (serialInterface.update()) {}
+    report("serial changes (5 of 32768 B)");
+    check(memcmp(data.data(), memory, size) == 0,
+          "serial write of changes wrote the wrong data to an EEPROM");
+    check(simulatedMicros - startedAt < 6 * eeprom.writeCycleMicros,
+          "serial write of changes took write cycles for unchanged pages");
+    resultsAt = skipFrameReplies(serial.output, TRANSFER_REPLY_LENGTH);
+    check(resultsAt && serial.output.size() == resultsAt + 4 + 1 + 4,
+          "serial write of changes sent the wrong number of bytes");
+    if (resultsAt && serial.output.size() == resultsAt + 4 + 1 + 4) {
+        check(readUint32(&serial.output[resultsAt]) ==
+              CRC32::calculate(data.data(), size),
+              "serial write of changes sent the wrong CRC");
+        check(readUint32(&serial.output[resultsAt + 4 + 1]) == 5,
+              "serial write of changes miscounted the changes");
+    }
+
+    // Erasing, a page per write cycle.
+    serial.output.clear();
+    serial.feed(static_cast<uint8_t>(0x0A)); // FILL
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feed(static_cast<uint8_t>(FILL_CONSTANT));
+    serial.feedUint32(0xFF);
+    serial.feedUint32(0);
+    serial.feedUint32(size);
+    SIMULATOR.resetCounters();
+    startedAt = simulatedMicros;
+    while (serialInterface.update()) {}
+    report("serial fill (32768 B)");
+    bool isErased = true;
+    for (uint32_t address = 0; address < size; address++) {
+        isErased = isErased && memory[address] == 0xFF;
+    }
+    check(isErased, "serial fill didn't erase the EEPROM");
+    check(simulatedMicros - startedAt <
+          2 * (size / MEMORY_CHIP_EEPROM_PAGE_SIZE) * eeprom.writeCycleMicros,
+          "serial fill took more than a write cycle per page");
+    check(serial.output.size() == 1 + 1 + 4 + 1 + 4 && serial.output[6] == 1,
+          "serial fill of an EEPROM failed");
+
+    // With software data protection on, writes need unlocking first.
+    SimulatedChip protectedEeprom = eeprom;
+    protectedEeprom.isDataProtected = true;
+    startOver(chip, protectedEeprom);
+    original.assign(memory, memory + size);
+    chip.analyze();
+    report("analyze (protected 28C256)");
+    chip.getProperties(&knownProperties, &properties);
+    check(properties.isOperational && properties.isSlow &&
+          properties.usesDataProtection,
+          "analyze: a protected EEPROM didn't come out protected");
+    check(memcmp(original.data(), memory, size) == 0,
+          "analyze didn't put the protected EEPROM's data back");
+    data = noise(4096, 5);
+    SIMULATOR.resetCounters();
+    written = chip.writeBytes(0x1000, data.data(), data.size());
+    report("writeBytes (protected, 4096 B)");
+    check(written == data.size() &&
+          memcmp(data.data(), memory + 0x1000, data.size()) == 0,
+          "writeBytes wrote the wrong bytes to a protected EEPROM");
+
+    // And without unlocking, nothing goes through, and writeBytes says so.
+    properties.usesDataProtection = false;
+    chip.setProperties(&knownProperties, &properties);
+    data = noise(256, 6);
+    written = chip.writeBytes(0x1000, data.data(), data.size());
+    check(written == 0, "writeBytes got through data protection");
+}
+
+// Not benchmarks so much as making sure analyze gets other chips right.
+template <class MemoryChipType>
+static void checkAnalyze(const char* title, MemoryChipType& chip)
+{
+    printHeader(title);
+    MemoryChipKnownProperties knownProperties;
+    MemoryChipProperties properties;
+
+    SimulatedChip sram;
+    sram.size = 8192;
+    sram.isNonVolatile = false;
+    startOver(chip, sram);
+    chip.analyze();
+    report("analyze (8 KiB SRAM)");
+    chip.getProperties(&knownProperties, &properties);
+    check(properties.isOperational, "analyze: not operational");
+    check(properties.size == 8192, "analyze: wrong size");
+    check(!properties.isNonVolatile, "analyze: SRAM came out non-volatile");
+
+    // SRAM that holds on for longer than the old fixed 10 ms power-off.
+    SimulatedChip longRetentionSram;
+    longRetentionSram.size = 8192;
+    longRetentionSram.isNonVolatile = false;
+    longRetentionSram.retentionMicros = 20000;
+    startOver(chip, longRetentionSram);
+    chip.analyze();
+    report("analyze (long-retention SRAM)");
+    chip.getProperties(&knownProperties, &properties);
+    check(!properties.isNonVolatile,
+          "analyze: long-retention SRAM came out non-volatile");
+
+    // How long SRAM takes to analyze, now that the non-volatility test
+    // stops as soon as the data's gone. (Time only passes in delays here,
+    // and in looks at the clock.) The timings are given, since calibrating
+    // them takes power cycles of its own.
+    startOver(chip, sram);
+    knownProperties = {false, false, false, false, true, true, false};
+    properties = {false, 0, false, false, 0, 0, false};
+    chip.setProperties(&knownProperties, &properties);
+    unsigned long startedAt = simulatedMicros;
+    chip.analyzeUnknownProperties();
+    check(simulatedMicros - startedAt < 2000,
+          "analyze: SRAM took 2 ms or more of powering off");
+
+    MemoryChipRetentionPoint points[MEMORY_CHIP_RETENTION_STEPS];
+    uint16_t numSamples = chip.measureRetention(points);
+    check(numSamples == MEMORY_CHIP_RETENTION_SAMPLES,
+          "measureRetention: wrong number of samples");
+    // The simulated SRAM keeps everything for 1 ms, then nothing.
+    check(points[0].offMicros == MEMORY_CHIP_RETENTION_MIN_OFF_MICROS &&
+          points[0].decayedCells == 0,
+          "measureRetention: decayed before the retention time");
+    for (uint8_t i = 1; i < MEMORY_CHIP_RETENTION_STEPS; i++) {
+        check(points[i].offMicros == points[i - 1].offMicros * 4 &&
+              points[i].decayedCells > numSamples / 2,
+              "measureRetention: didn't decay after the retention time");
+    }
+
+    // Chips that keep up get no extra waiting at all...
+    SimulatedChip fram;
+    startOver(chip, fram);
+    chip.analyze();
+    chip.getProperties(&knownProperties, &properties);
+    check(knownProperties.powerOnSettleMicros && properties.powerOnSettleMicros == 0 &&
+          knownProperties.strobeMicros && properties.strobeMicros == 0,
+          "analyze: FRAM that keeps up got extra waiting");
+
+    // ...and ones that don't get enough, plus the margin. This one ignores
+    // accesses for a while after powering on, like some FM18W08s, and has
+    // a slow access time on top.
+    SimulatedChip slowChip;
+    slowChip.powerOnSettleMicros = 130;
+    slowChip.accessMicros = 3;
+    startOver(chip, slowChip);
+    chip.analyze();
+    report("analyze (slow timing)");
+    chip.getProperties(&knownProperties, &properties);
+    check(properties.isOperational && properties.size == 32768 &&
+          properties.isNonVolatile && !properties.isSlow,
+          "analyze: a chip with slow timing came out wrong");
+    check(properties.powerOnSettleMicros >= 130 &&
+          properties.powerOnSettleMicros <= 130 * (100 + MEMORY_CHIP_TIMING_MARGIN_PERCENT) / 100 + 1,
+          "analyze: wrong power-on settle time");
+    check(properties.strobeMicros >= 3 &&
+          properties.strobeMicros <= 3 * (100 + MEMORY_CHIP_TIMING_MARGIN_PERCENT) / 100 + 1,
+          "analyze: wrong strobe time");
+    chip.powerOff();
+    chip.powerOn();
+    chip.switchToWriteMode();
+    chip.writeByte(0x1234, 0x42);
+    chip.switchToReadMode();
+    check(chip.readByte(0x1234) == 0x42,
+          "calibrated timing doesn't work right after powering on");
+
+    SimulatedChip emptySocket;
+    emptySocket.isPresent = false;
+    startOver(chip, emptySocket);
+    chip.analyze();
+    report("analyze (no chip)");
+    chip.getProperties(&knownProperties, &properties);
+    check(!properties.isOperational, "analyze: an empty socket works?");
+}
+
+// Stands in for software.ino's setUartBaudRate.
+static uint32_t simulatedBaudRate = FRAMUNE_DEFAULT_BAUD_RATE;
+static bool setSimulatedBaudRate(uint32_t baudRate, bool isSwitching)
+{
+    if (F_CPU % (8 * baudRate) != 0 && baudRate != FRAMUNE_DEFAULT_BAUD_RATE) {
+        return false;
+    }
+    if (isSwitching) {
+        simulatedBaudRate = baudRate;
+    }
+    return true;
+}
+
+static void checkFrameCompression()
+{
+    printf("\nFrame compression\n");
+    std::vector<std::vector<uint8_t>> frames;
+    frames.push_back(std::vector<uint8_t>(FRAMUNE_FRAME_SIZE, 0x00));
+    frames.push_back(std::vector<uint8_t>(FRAMUNE_FRAME_SIZE, 0xFF));
+    frames.push_back(noise(FRAMUNE_FRAME_SIZE, 7));
+    std::vector<uint8_t> frame(FRAMUNE_FRAME_SIZE);
+    for (uint32_t i = 0; i < FRAMUNE_FRAME_SIZE; i++) {
+        frame[i] = i;
+    }
+    frames.push_back(frame);
+    for (uint32_t i = 0; i < FRAMUNE_FRAME_SIZE; i++) {
+        frame[i] = "ABCDE"[i % 5];
+    }
+    frames.push_back(frame);
+    frame = noise(FRAMUNE_FRAME_SIZE, 8);
+    memset(&frame[10], 0x00, 20);
+    memcpy(&frame[40], &frame[0], 12);
+    frames.push_back(frame);
+
+    uint32_t totalLength = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        uint8_t compressed[FRAMUNE_FRAME_SIZE];
+        uint8_t length = compressFrame(frames[i].data(), FRAMUNE_FRAME_SIZE, compressed);
+        totalLength += length;
+        if (length == FRAMUNE_FRAME_SIZE) {
+            continue;
+        }
+        std::vector<uint8_t> expanded(FRAMUNE_FRAME_SIZE);
+        check(expandFrame(compressed, length, expanded.data(), FRAMUNE_FRAME_SIZE) &&
+              expanded == frames[i],
+              "a compressed frame didn't expand back to what it was");
+        check(!expandFrame(compressed, length - 1, expanded.data(), FRAMUNE_FRAME_SIZE),
+              "a cut-off compressed frame expanded anyway");
+    }
+    printf("%u frames of %u B compressed to %lu B\n",
+           static_cast<unsigned>(frames.size()), FRAMUNE_FRAME_SIZE,
+           static_cast<unsigned long>(totalLength));
+    check(compressFrame(frames[0].data(), FRAMUNE_FRAME_SIZE, frame.data()) == 2,
+          "a blank frame didn't compress to a single run");
+    check(compressFrame(frames[2].data(), FRAMUNE_FRAME_SIZE, frame.data()) ==
+          FRAMUNE_FRAME_SIZE, "noise compressed");
+    // A copy from before the start of the frame.
+    static const uint8_t garbage[] = {0x00, 0x41, 0x85, 0x05};
+    check(!expandFrame(garbage, sizeof(garbage), frame.data(), FRAMUNE_FRAME_SIZE),
+          "a garbled compressed frame expanded anyway");
+}
+
+static void checkBaudRates()
+{
+    SimulatedSerial serial;
+    BasicSerialInterface<NanoMemoryChip> serialInterface(&serial, &NANO_MEMORY_CHIP,
+                                                         setSimulatedBaudRate);
+    static const uint8_t checkSequence[] = {0x55, 0xAA, 0xF0, 0x0F};
+
+    // Some garbage from the host switching over comes before the sequence.
+    serial.feed(static_cast<uint8_t>(0x0D)); // SET_BAUD_RATE
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feedUint32(1000000);
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feed(static_cast<uint8_t>(0x55));
+    serial.feed(checkSequence, sizeof(checkSequence));
+    while (serialInterface.update()) {}
+    check(serial.output.size() == 2 + sizeof(checkSequence) && serial.output[1] == 1 &&
+          memcmp(&serial.output[2], checkSequence, sizeof(checkSequence)) == 0,
+          "set baud rate: didn't echo the check sequence");
+    check(simulatedBaudRate == 1000000, "set baud rate: didn't switch");
+
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x0D));
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feedUint32(300000);
+    while (serialInterface.update()) {}
+    check(serial.output.size() == 2 && serial.output[1] == 0 &&
+          simulatedBaudRate == 1000000,
+          "set baud rate: switched to an inexact baud rate");
+
+    // No check sequence, like when the host can't do the baud rate.
+    serial.clear();
+    serial.feed(static_cast<uint8_t>(0x0D));
+    serial.feed(static_cast<uint8_t>(0x00));
+    serial.feedUint32(2000000);
+    while (serialInterface.update()) {}
+    check(serial.output.size() == 2 && serial.output[1] == 1 &&
+          simulatedBaudRate == 1000000,
+          "set baud rate: didn't switch back after no check sequence");
+
+    serialInterface.update();
+    check(simulatedBaudRate == 1000000, "set baud rate: went back too soon");
+    delay(FRAMUNE_BAUD_RATE_IDLE_MILLIS);
+    serialInterface.update();
+    check(simulatedBaudRate == FRAMUNE_DEFAULT_BAUD_RATE,
+          "set baud rate: didn't go back to the default when idle");
+}
+
+int main()
+{
+    CRC32 crc;
+    crc.update("123456789", 9);
+    if (crc.finalize() != 0xCBF43926) {
+        printf("The mock CRC32 is broken!\n");
+        return 1;
+    }
+
+    benchmarkChip("Nano layout (BasicMemoryChip, static pins, PinBus)",
+                  NANO_MEMORY_CHIP);
+    benchmarkChip("Runtime layout (MemoryChip, RuntimePin, InputOutput_Port)",
+                  RUNTIME_MEMORY_CHIP);
+    benchmarkMarchTests("March tests (Nano layout)", NANO_MEMORY_CHIP);
+    benchmarkDiagnoseLines("Line diagnosis (Nano layout)", NANO_MEMORY_CHIP);
+    benchmarkWideChip("24-bit addresses (Nano layout plus a 74HC595)",
+                      WIDE_MEMORY_CHIP);
+    benchmarkEeprom("EEPROM (Nano layout)", NANO_MEMORY_CHIP);
+    checkAnalyze("Other chips (Nano layout)", NANO_MEMORY_CHIP);
+    checkFrameCompression();
+    checkBaudRates();
+
+    if (failures) {
+        printf("\n%d check(s) failed.\n", failures);
+        return 1;
+    }
+    printf("\nAll checks passed.\n");
+    return 0;
+}
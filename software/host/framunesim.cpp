@@ -0,0 +1,113 @@
+// The firmware on the simulated board (the Nano layout, with a 32 KiB FRAM),
+// with its serial port on stdin and stdout - so that framune.py can talk to
+// it through a pty, like it would to a real F-Ramune. See test_framing.py.
+// Time passes for real here, as far as the firmware's timeouts can tell.
+
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <Arduino.h>
+#include <SPI.h>
+#include "simulator.hpp"
+#include "channelio.hpp"
+#include "memorychip.hpp"
+#include "serialinterface.hpp"
+
+typedef Output_SpiShiftRegister<uint16_t, StaticPin<10>> NanoAddressChannel;
+typedef InputOutput_PinBus<A0, A1, A2, 3, 4, 5, 6, 7> NanoDataChannel;
+typedef MemoryChipStaticPins<A4, A5, 2, A3> NanoControlPins;
+typedef BasicMemoryChip<NanoAddressChannel, NanoDataChannel, NanoControlPins>
+    NanoMemoryChip;
+
+NanoAddressChannel NANO_ADDRESS_CHANNEL(20000000, SPI_MODE0, StaticPin<10>());
+NanoDataChannel NANO_DATA_CHANNEL(INPUT_PULLUP);
+NanoMemoryChip NANO_MEMORY_CHIP(&NANO_ADDRESS_CHANNEL, &NANO_DATA_CHANNEL,
+                                NanoControlPins(), HIGH);
+
+static unsigned long realMicros()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+}
+
+static unsigned long startedAt;
+static bool isInputClosed = false;
+
+// Brings the simulated clock up to the real one. It only ever goes forward,
+// though, and delays can put it ahead for a bit.
+static void catchUp()
+{
+    unsigned long now = realMicros() - startedAt;
+    if (now > simulatedMicros) {
+        simulatedMicros = now;
+    }
+}
+
+class StdioSerial : public Stream
+{
+public:
+    int available() override
+    {
+        catchUp();
+        uint8_t buffer[256];
+        ssize_t length = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (length > 0) {
+            _input.insert(_input.end(), buffer, buffer + length);
+        } else if (length == 0) {
+            isInputClosed = true;
+        } else if (_input.empty() && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Nothing to do but wait, so don't spin too hard.
+            usleep(50);
+        }
+        return _input.size();
+    }
+
+    int peek() override
+    {
+        if (!available()) {return -1;}
+        return _input.front();
+    }
+
+    int read() override
+    {
+        if (!available()) {return -1;}
+        uint8_t n = _input.front();
+        _input.pop_front();
+        return n;
+    }
+
+    size_t write(uint8_t n) override
+    {
+        return ::write(STDOUT_FILENO, &n, 1) == 1;
+    }
+    using Print::write;
+
+    int availableForWrite() override {return 64;}
+private:
+    std::deque<uint8_t> _input;
+};
+
+static bool acceptAnyBaudRate(uint32_t, bool)
+{
+    return true;
+}
+
+int main()
+{
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    startedAt = realMicros();
+
+    SIMULATOR.reset(SimulatorWiring(), SimulatedChip());
+    NANO_MEMORY_CHIP.initPins();
+    StdioSerial serial;
+    BasicSerialInterface<NanoMemoryChip> serialInterface(&serial, &NANO_MEMORY_CHIP,
+                                                         acceptAnyBaudRate);
+    while (!isInputClosed) {
+        serialInterface.update();
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+#ifndef HOST_MOCK_ARDUINO_H
+#define HOST_MOCK_ARDUINO_H
+
+// A stand-in for the bits of the Arduino core (and avr-libc) that the
+// firmware uses, so that it can be built and run on a PC. The IO registers
+// are objects that tell the simulator (see simulator.hpp) whenever the
+// firmware writes to them, which is how the simulated chip gets driven.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Pretend to be a Nano, so that StaticPin and friends know the pinout.
+#ifndef __AVR_ATmega328P__
+#define __AVR_ATmega328P__
+#endif
+#define F_CPU 16000000UL
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define _BV(bit) (1 << (bit))
+
+#define PROGMEM
+#define pgm_read_byte(address) (*reinterpret_cast<const uint8_t*>(address))
+#define memcpy_P memcpy
+
+class SimRegister
+{
+public:
+    explicit SimRegister(uint8_t value = 0) : _value(value) {}
+    SimRegister(const SimRegister&) = delete;
+
+    operator uint8_t() const {return _value;}
+    SimRegister& operator=(const SimRegister& other)
+    {
+        _write(other._value);
+        return *this;
+    }
+    SimRegister& operator=(uint8_t value) {_write(value); return *this;}
+    SimRegister& operator|=(uint8_t bits) {_write(_value | bits); return *this;}
+    SimRegister& operator&=(uint8_t bits) {_write(_value & bits); return *this;}
+    SimRegister& operator^=(uint8_t bits) {_write(_value ^ bits); return *this;}
+
+    // Changes the value without it counting as the firmware writing to it.
+    // For the simulator's side of things, like the PINx registers.
+    void set(uint8_t value) {_value = value;}
+private:
+    void _write(uint8_t value);
+    uint8_t _value;
+};
+
+// Called after every write the firmware makes to a register.
+extern void (*simRegisterWriteHook)(SimRegister& reg, uint8_t oldValue);
+
+// Makes fastpins.hpp use SimRegister for its register type.
+#define FASTPINS_REGISTER_TYPE SimRegister
+
+extern SimRegister PINB, PORTB, DDRB;
+extern SimRegister PINC, PORTC, DDRC;
+extern SimRegister PIND, PORTD, DDRD;
+extern SimRegister SPCR, SPSR, SPDR;
+
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+#define SPIF 7
+#define WCOL 6
+#define SPI2X 0
+
+// The Nano's pinout, from the Arduino core's pins_arduino.h.
+#define NUM_DIGITAL_PINS 20
+#define NOT_A_PORT 0
+#define PB 2
+#define PC 3
+#define PD 4
+
+static const uint8_t SS = 10;
+static const uint8_t MOSI = 11;
+static const uint8_t MISO = 12;
+static const uint8_t SCK = 13;
+
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+static const uint8_t A6 = 20;
+static const uint8_t A7 = 21;
+
+inline uint8_t digitalPinToPort(uint8_t pin)
+{
+    return pin >= NUM_DIGITAL_PINS ? NOT_A_PORT : pin < 8 ? PD : pin < 14 ? PB : PC;
+}
+
+inline uint8_t digitalPinToBitMask(uint8_t pin)
+{
+    return 1 << (pin < 8 ? pin : pin < 14 ? pin - 8 : pin - 14);
+}
+
+inline SimRegister* portInputRegister(uint8_t port)
+{
+    return port == PB ? &PINB : port == PC ? &PINC : port == PD ? &PIND : NULL;
+}
+
+inline SimRegister* portOutputRegister(uint8_t port)
+{
+    return port == PB ? &PORTB : port == PC ? &PORTC : port == PD ? &PORTD : NULL;
+}
+
+inline SimRegister* portModeRegister(uint8_t port)
+{
+    return port == PB ? &DDRB : port == PC ? &DDRC : port == PD ? &DDRD : NULL;
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+// There's no real clock: time only passes in delays, plus a microsecond on
+// every look at the time, so that busy-waits on millis() always finish.
+extern unsigned long simulatedMicros;
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+// Called after every delay, for anything that changes as time passes.
+extern void (*simTimeHook)();
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t n) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t written = 0;
+        while (size--) {
+            written += write(*buffer++);
+        }
+        return written;
+    }
+    size_t write(const char* str)
+    {
+        return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0;
+    }
+    virtual int availableForWrite() {return 0;}
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeout) {_timeout = timeout;}
+    unsigned long getTimeout() {return _timeout;}
+protected:
+    unsigned long _timeout = 1000;
+};
+
+#endif
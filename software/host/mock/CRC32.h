@@ -0,0 +1,41 @@
+#ifndef HOST_MOCK_CRC32_H
+#define HOST_MOCK_CRC32_H
+
+// Same interface as the CRC32 library the firmware uses (bakercp/CRC32),
+// and the same CRC - the one zlib.crc32 computes on the host side.
+
+#include <stdint.h>
+#include <stddef.h>
+
+class CRC32
+{
+public:
+    CRC32() {reset();}
+    void reset() {_state = 0xFFFFFFFFUL;}
+    void update(uint8_t data)
+    {
+        _state ^= data;
+        for (int i = 0; i < 8; i++) {
+            _state = (_state >> 1) ^ (-(_state & 1) & 0xEDB88320UL);
+        }
+        _state &= 0xFFFFFFFFUL;
+    }
+    template <class T> void update(const T* data, size_t size)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        while (size--) {
+            update(*bytes++);
+        }
+    }
+    uint32_t finalize() const {return ~_state & 0xFFFFFFFFUL;}
+    template <class T> static uint32_t calculate(const T* data, size_t size)
+    {
+        CRC32 crc;
+        crc.update(data, size);
+        return crc.finalize();
+    }
+private:
+    unsigned long _state;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef HOST_MOCK_SPI_H
+#define HOST_MOCK_SPI_H
+
+// The AVR SPI library, boiled down to the register accesses it makes.
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings
+{
+public:
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode)
+    {
+        (void) clock;
+        spcr = _BV(SPE) | _BV(MSTR) | (bitOrder == LSBFIRST ? _BV(DORD) : 0) |
+               (dataMode & (_BV(CPOL) | _BV(CPHA)));
+    }
+    SPISettings() : SPISettings(4000000, MSBFIRST, SPI_MODE0) {}
+    uint8_t spcr;
+};
+
+class SPIClass
+{
+public:
+    static void begin()
+    {
+        digitalWrite(SS, HIGH);
+        pinMode(SS, OUTPUT);
+        SPCR |= _BV(MSTR);
+        SPCR |= _BV(SPE);
+        pinMode(SCK, OUTPUT);
+        pinMode(MOSI, OUTPUT);
+    }
+    static void end() {SPCR &= ~_BV(SPE);}
+    static void beginTransaction(SPISettings settings) {SPCR = settings.spcr;}
+    static void endTransaction() {}
+    static uint8_t transfer(uint8_t data)
+    {
+        SPDR = data;
+        while (!(SPSR & _BV(SPIF))) {}
+        return SPDR;
+    }
+};
+
+extern SPIClass SPI;
+
+#endif
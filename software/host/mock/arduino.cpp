@@ -0,0 +1,86 @@
+#include <Arduino.h>
+#include <SPI.h>
+
+void (*simRegisterWriteHook)(SimRegister& reg, uint8_t oldValue) = NULL;
+
+void SimRegister::_write(uint8_t value)
+{
+    uint8_t oldValue = _value;
+    _value = value;
+    if (simRegisterWriteHook) {
+        simRegisterWriteHook(*this, oldValue);
+    }
+}
+
+SimRegister PINB, PORTB, DDRB;
+SimRegister PINC, PORTC, DDRC;
+SimRegister PIND, PORTD, DDRD;
+SimRegister SPCR, SPSR, SPDR;
+
+SPIClass SPI;
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    uint8_t port = digitalPinToPort(pin);
+    if (port == NOT_A_PORT) {return;}
+    uint8_t bitMask = digitalPinToBitMask(pin);
+    SimRegister& out = *portOutputRegister(port);
+    SimRegister& direction = *portModeRegister(port);
+    if (mode == INPUT) {
+        direction &= ~bitMask;
+        out &= ~bitMask;
+    } else if (mode == INPUT_PULLUP) {
+        direction &= ~bitMask;
+        out |= bitMask;
+    } else {
+        direction |= bitMask;
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    uint8_t port = digitalPinToPort(pin);
+    if (port == NOT_A_PORT) {return;}
+    uint8_t bitMask = digitalPinToBitMask(pin);
+    if (value == LOW) {
+        *portOutputRegister(port) &= ~bitMask;
+    } else {
+        *portOutputRegister(port) |= bitMask;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    uint8_t port = digitalPinToPort(pin);
+    if (port == NOT_A_PORT) {return LOW;}
+    return *portInputRegister(port) & digitalPinToBitMask(pin) ? HIGH : LOW;
+}
+
+unsigned long simulatedMicros = 0;
+void (*simTimeHook)() = NULL;
+
+unsigned long millis()
+{
+    return simulatedMicros++ / 1000;
+}
+
+unsigned long micros()
+{
+    return simulatedMicros++;
+}
+
+void delay(unsigned long ms)
+{
+    simulatedMicros += ms * 1000;
+    if (simTimeHook) {
+        simTimeHook();
+    }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    simulatedMicros += us;
+    if (simTimeHook) {
+        simTimeHook();
+    }
+}
@@ -0,0 +1,409 @@
+#include "simulator.hpp"
+
+#include <stdint.h>
+#include <Arduino.h>
+
+Simulator SIMULATOR;
+
+static void forwardRegisterWrite(SimRegister& reg, uint8_t oldValue)
+{
+    SIMULATOR.onRegisterWrite(reg, oldValue);
+}
+
+static void forwardTimePassing()
+{
+    SIMULATOR.onTimePassing();
+}
+
+void Simulator::reset(const SimulatorWiring& wiring, const SimulatedChip& chip)
+{
+    simRegisterWriteHook = NULL;
+    simTimeHook = NULL;
+    SimRegister* registers[] = {
+        &PINB, &PORTB, &DDRB, &PINC, &PORTC, &DDRC, &PIND, &PORTD, &DDRD,
+        &SPCR, &SPSR, &SPDR
+    };
+    for (SimRegister* reg : registers) {
+        reg->set(0);
+    }
+
+    _wiring = wiring;
+    _chip = chip;
+    // Sizes that aren't a power of two aren't a thing here.
+    _memory.assign(_chip.size, 0);
+    _noiseState = 0x12345678;
+    _fillWithNoise();
+
+    _shiftRegister = 0;
+    _latchedAddress = 0;
+    _latch = false;
+    _isPowered = false;
+    _poweredOffAt = simulatedMicros;
+    _poweredOnAt = simulatedMicros;
+    _ceActive = false;
+    _ceActiveAt = simulatedMicros;
+    _isIgnoringStrobe = false;
+    _pageData.assign(_chip.pageSize, 0);
+    _isPageByteLoaded.assign(_chip.pageSize, false);
+    _pageAddress = 0;
+    _isLoadingPage = false;
+    _lastLoadAt = simulatedMicros;
+    _lastLoadedByte = 0;
+    _isWriteCycleRunning = false;
+    _writeCycleStartedAt = simulatedMicros;
+    _toggleBit = false;
+    _isDataProtected = _chip.isDataProtected;
+    _isUnlocked = false;
+    _commandStep = 0;
+    _commandBytes.clear();
+    _isWriting = false;
+    _isDriving = false;
+    _isContending = false;
+    resetCounters();
+
+    simRegisterWriteHook = forwardRegisterWrite;
+    simTimeHook = forwardTimePassing;
+    _update();
+}
+
+void Simulator::resetCounters()
+{
+    counters = SimulatorCounters();
+}
+
+void Simulator::onRegisterWrite(SimRegister& reg, uint8_t)
+{
+    if (&reg == &SPDR) {
+        // The whole byte goes through the chain in one go - there's no
+        // point in simulating SCK when nothing can happen halfway through.
+        uint32_t chainMask = (static_cast<uint32_t>(1) << _wiring.shiftRegisterBits) - 1;
+        _shiftRegister = ((_shiftRegister << 8) | reg) & chainMask;
+        SPSR.set(SPSR | _BV(SPIF));
+        counters.spiBytes++;
+        return;
+    }
+    if (&reg == &SPCR) {
+        counters.spiTransactions++;
+        return;
+    }
+
+    bool isDirection = &reg == &DDRB || &reg == &DDRC || &reg == &DDRD;
+    bool isOutput = &reg == &PORTB || &reg == &PORTC || &reg == &PORTD;
+    if (!isDirection && !isOutput) {
+        return;
+    }
+    counters.portWrites++;
+    if (isDirection && _isDataRegister(reg)) {
+        counters.busDirectionWrites++;
+    }
+    _update();
+}
+
+void Simulator::onTimePassing()
+{
+    // A read that's been waiting for the chip might have its data now.
+    _update();
+}
+
+void Simulator::_update()
+{
+    // 74HC595s latch on the rising edge of RCLK.
+    bool latch = _outputLevel(_wiring.latchPin);
+    if (latch && !_latch) {
+        _latchedAddress = _shiftRegister;
+    }
+    _latch = latch;
+
+    bool isPowered = _chip.isPresent &&
+                     _isOutput(_wiring.powerPin) &&
+                     _outputLevel(_wiring.powerPin) == _wiring.powerPinOnState;
+    if (isPowered && !_isPowered) {
+        counters.powerCycles++;
+        _poweredOnAt = simulatedMicros;
+        if (!_chip.isNonVolatile &&
+            simulatedMicros - _poweredOffAt >= _chip.retentionMicros) {
+            _fillWithNoise();
+        }
+    } else if (!isPowered && _isPowered) {
+        _poweredOffAt = simulatedMicros;
+    }
+    _isPowered = isPowered;
+
+    bool ceActive = isPowered && !_outputLevel(_wiring.cePin);
+    bool oeActive = isPowered && !_outputLevel(_wiring.oePin);
+    bool weActive = isPowered && !_outputLevel(_wiring.wePin);
+
+    if (ceActive && !_ceActive) {
+        counters.strobes++;
+        _ceActiveAt = simulatedMicros;
+        _isIgnoringStrobe = simulatedMicros - _poweredOnAt < _chip.powerOnSettleMicros;
+    }
+    _ceActive = ceActive;
+    // EEPROMs can be read just fine while they're still not taking writes.
+    oeActive = oeActive && (!_isIgnoringStrobe || _chip.writeCycleMicros);
+    weActive = weActive && !_isIgnoringStrobe;
+
+    // An EEPROM starts writing its page once the loading's over. 150 µs
+    // without another byte is how a 28C256 tells.
+    if (_isLoadingPage && (simulatedMicros - _lastLoadAt >= 150 ||
+                           (ceActive && oeActive && !weActive))) {
+        _startWriteCycle();
+    }
+
+    // Writes happen on whichever of CE or WE goes inactive first.
+    bool isWriting = ceActive && weActive;
+    if (_isWriting && !isWriting && isPowered && _isAccessDone()) {
+        _writeChip(_chipAddress(), _mcuBusValue() & ~_chip.openDataLines);
+        counters.chipWrites++;
+    }
+    _isWriting = isWriting;
+
+    bool isDriving = ceActive && oeActive && !weActive;
+    if (isDriving && !_isDriving) {
+        counters.chipReads++;
+        _toggleBit = !_toggleBit;
+    }
+    _isDriving = isDriving;
+
+    bool isContending = false;
+    if (isDriving) {
+        for (uint8_t pin : _wiring.dataPins) {
+            isContending = isContending || _isOutput(pin);
+        }
+    }
+    if (isContending && !_isContending) {
+        counters.busContentions++;
+    }
+    _isContending = isContending;
+
+    _updateInputs();
+}
+
+void Simulator::_updateInputs()
+{
+    const uint8_t ports[] = {PB, PC, PD};
+    for (uint8_t port : ports) {
+        uint8_t out = *portOutputRegister(port);
+        uint8_t direction = *portModeRegister(port);
+        // Outputs read back what they're driving. Inputs with pull-ups
+        // enabled read high, and floating ones are taken to read low.
+        uint8_t in = out;
+        for (uint8_t i = 0; i < 8; i++) {
+            uint8_t pin = _wiring.dataPins[i];
+            uint8_t bitMask = digitalPinToBitMask(pin);
+            if (_isDriving && digitalPinToPort(pin) == port && !(direction & bitMask) &&
+                !(_chip.openDataLines & (1 << i))) {
+                uint8_t value = _isAccessDone() ? _chipValue() : ~_chipValue();
+                uint8_t bit = (value >> i) & 1;
+                in = bit ? in | bitMask : in & ~bitMask;
+            }
+        }
+        portInputRegister(port)->set(in);
+    }
+}
+
+bool Simulator::_isAccessDone()
+{
+    return simulatedMicros - _ceActiveAt >= _chip.accessMicros;
+}
+
+void Simulator::_fillWithNoise()
+{
+    // Whatever a chip wakes up with, as far as the firmware can tell.
+    for (uint8_t& n : _memory) {
+        _noiseState = _noiseState * 1103515245 + 12345;
+        n = static_cast<uint8_t>(_noiseState >> 16);
+    }
+}
+
+bool Simulator::_isDataRegister(SimRegister& reg)
+{
+    for (uint8_t pin : _wiring.dataPins) {
+        if (portModeRegister(digitalPinToPort(pin)) == &reg) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Simulator::_isOutput(uint8_t pin)
+{
+    return *portModeRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin);
+}
+
+bool Simulator::_outputLevel(uint8_t pin)
+{
+    // For an input, that's whether its pull-up is on - close enough for
+    // control lines, which the firmware makes outputs early on anyway.
+    return *portOutputRegister(digitalPinToPort(pin)) & digitalPinToBitMask(pin);
+}
+
+uint32_t Simulator::_chipAddress()
+{
+    uint32_t address = _latchedAddress & ~_chip.stuckLowAddressLines;
+    if ((address & _chip.shortedAddressLines) != _chip.shortedAddressLines) {
+        address &= ~_chip.shortedAddressLines;
+    }
+    return address & (_chip.size - 1);
+}
+
+void Simulator::_writeChip(uint32_t address, uint8_t value)
+{
+    if (_chip.writeCycleMicros) {
+        _loadEepromByte(address, value);
+    } else {
+        _memory[address] = value;
+    }
+}
+
+void Simulator::_loadEepromByte(uint32_t address, uint8_t value)
+{
+    if (_isEepromBusy()) {
+        return;
+    }
+
+    // Software data protection's command sequences: AA 55 A0 turns it on
+    // and unlocks the page that follows, and AA 55 80 AA 55 20 turns it off.
+    uint32_t address5555 = 0x5555 & (_chip.size - 1);
+    uint32_t address2AAA = 0x2AAA & (_chip.size - 1);
+    uint8_t step = _commandStep;
+    bool isCommand =
+        ((step == 0 || step == 3) && address == address5555 && value == 0xAA) ||
+        ((step == 1 || step == 4) && address == address2AAA && value == 0x55) ||
+        (step == 2 && address == address5555 && (value == 0xA0 || value == 0x80)) ||
+        (step == 5 && address == address5555 && value == 0x20);
+    if (isCommand) {
+        _commandBytes.push_back(std::make_pair(address, value));
+        _lastLoadAt = simulatedMicros;
+        if (step == 2 && value == 0xA0) {
+            _isDataProtected = true;
+            _isUnlocked = true;
+            _commandStep = 0;
+            _commandBytes.clear();
+        } else if (step == 5) {
+            _isDataProtected = false;
+            _commandStep = 0;
+            _commandBytes.clear();
+        } else {
+            _commandStep++;
+        }
+        return;
+    }
+
+    // Whatever looked like the start of a command was just data after all.
+    for (const std::pair<uint32_t, uint8_t>& commandByte : _commandBytes) {
+        _loadPageByte(commandByte.first, commandByte.second);
+    }
+    _commandBytes.clear();
+    _commandStep = 0;
+    _loadPageByte(address, value);
+}
+
+void Simulator::_loadPageByte(uint32_t address, uint8_t value)
+{
+    if (_isDataProtected && !_isUnlocked) {
+        return;
+    }
+    // The page is whichever one the first byte went to. Any others wrap
+    // around within it, like on the real thing.
+    if (!_isLoadingPage) {
+        _isLoadingPage = true;
+        _pageAddress = address & ~(_chip.pageSize - 1);
+        _isPageByteLoaded.assign(_chip.pageSize, false);
+    }
+    uint32_t offset = address & (_chip.pageSize - 1);
+    _pageData[offset] = value;
+    _isPageByteLoaded[offset] = true;
+    _lastLoadedByte = value;
+    _lastLoadAt = simulatedMicros;
+}
+
+void Simulator::_startWriteCycle()
+{
+    for (uint32_t i = 0; i < _chip.pageSize; i++) {
+        if (_isPageByteLoaded[i]) {
+            _memory[_pageAddress + i] = _pageData[i];
+        }
+    }
+    _isLoadingPage = false;
+    _isUnlocked = false;
+    _isWriteCycleRunning = true;
+    _writeCycleStartedAt = simulatedMicros;
+}
+
+bool Simulator::_isEepromBusy()
+{
+    _isWriteCycleRunning = _isWriteCycleRunning &&
+        simulatedMicros - _writeCycleStartedAt < _chip.writeCycleMicros;
+    return _isWriteCycleRunning;
+}
+
+uint8_t Simulator::_chipValue()
+{
+    if (_isEepromBusy()) {
+        // DATA# on bit 7, and bit 6 toggling with every read.
+        return (_lastLoadedByte & 0x3F) | (~_lastLoadedByte & 0x80) |
+               (_toggleBit ? 0x40 : 0);
+    }
+    uint32_t address = _chipAddress();
+    uint8_t value = _memory[address];
+    if (address == _chip.stuckBitsAddress) {
+        value = (value & ~_chip.stuckBitsMask) |
+                (_chip.stuckBitsValue & _chip.stuckBitsMask);
+    }
+    return value;
+}
+
+uint8_t Simulator::_mcuBusValue()
+{
+    uint8_t value = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        if (_outputLevel(_wiring.dataPins[i])) {
+            value |= 1 << i;
+        }
+    }
+    return value;
+}
+
+int SimulatedSerial::read()
+{
+    if (_input.empty()) {return -1;}
+    uint8_t n = _input.front();
+    _input.pop_front();
+    return n;
+}
+
+int SimulatedSerial::peek()
+{
+    return _input.empty() ? -1 : _input.front();
+}
+
+size_t SimulatedSerial::write(uint8_t n)
+{
+    output.push_back(n);
+    return 1;
+}
+
+void SimulatedSerial::feed(const uint8_t* data, size_t length)
+{
+    _input.insert(_input.end(), data, data + length);
+}
+
+void SimulatedSerial::feedUint16(uint16_t n)
+{
+    feed(static_cast<uint8_t>(n >> 8));
+    feed(static_cast<uint8_t>(n));
+}
+
+void SimulatedSerial::feedUint32(uint32_t n)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        feed(static_cast<uint8_t>(n >> shift));
+    }
+}
+
+void SimulatedSerial::clear()
+{
+    _input.clear();
+    output.clear();
+}
@@ -0,0 +1,184 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <Arduino.h>
+
+// A simulated f-ramune board: a chain of 74HC595s fed over SPI, and a
+// parallel memory chip (FRAM or SRAM) behind them, both driven entirely by
+// what the firmware does to the (mock) IO registers. Along the way, it
+// counts everything the firmware makes the hardware do, which is what the
+// benchmarks report.
+
+// How the board's wired up. Defaults to the Nano layout in software.ino.
+struct SimulatorWiring
+{
+    uint8_t cePin = A4;
+    uint8_t oePin = A5;
+    uint8_t wePin = 2;
+    uint8_t powerPin = A3;
+    uint8_t powerPinOnState = HIGH;
+    uint8_t latchPin = 10;
+    // Bit 0 of the data bus first.
+    uint8_t dataPins[8] = {A0, A1, A2, 3, 4, 5, 6, 7};
+    // The length of the 74HC595 chain.
+    uint8_t shiftRegisterBits = 16;
+};
+
+struct SimulatedChip
+{
+    bool isPresent = true;
+    uint32_t size = 32768;
+    bool isNonVolatile = true;
+    // How long an SRAM chip holds on to its contents with the power off.
+    // Real ones vary a lot; see MemoryChip's non-volatility test.
+    unsigned long retentionMicros = 1000;
+    // How long the chip ignores accesses for after powering on, like some
+    // FM18W08s do (see MemoryChip::powerOn). EEPROMs only ignore writes.
+    unsigned long powerOnSettleMicros = 0;
+    // How long CE has to be active for a read to have the data ready, and
+    // for a write to stick. Until then, reads come back garbled.
+    unsigned long accessMicros = 0;
+    // For an EEPROM (a 28C256, say), how long it's busy writing a page for.
+    // Writes load the page buffer, and the chip starts writing it when no
+    // more come in for a while, or when it's read. While it's busy, reads
+    // give the status for DATA# and toggle-bit polling, and writes are
+    // ignored. 0 for chips that write right away.
+    unsigned long writeCycleMicros = 0;
+    uint32_t pageSize = 64;
+    // Whether the EEPROM's software data protection starts out on.
+    bool isDataProtected = false;
+    // Faults to make the tests find. Bits set in stuckBitsMask always read
+    // back as they are in stuckBitsValue, at stuckBitsAddress.
+    uint32_t stuckBitsAddress = 0;
+    uint8_t stuckBitsMask = 0;
+    uint8_t stuckBitsValue = 0;
+    // Address lines that are stuck low, as a mask.
+    uint32_t stuckLowAddressLines = 0;
+    // Address lines that are shorted together, as a mask. They're all low
+    // unless they're all high - a wired AND, in other words.
+    uint32_t shortedAddressLines = 0;
+    // Data lines that don't reach the chip, as a mask. They read as the
+    // MCU's pull-ups make them, and the chip takes them as low.
+    uint8_t openDataLines = 0;
+};
+
+struct SimulatorCounters
+{
+    // Writes to any PORTx or DDRx register.
+    unsigned long portWrites;
+    // Writes to a DDRx register that has data lines on it - in other words,
+    // what switching between read and write mode costs.
+    unsigned long busDirectionWrites;
+    unsigned long spiBytes;
+    // SPI.beginTransaction calls, as seen through SPCR writes.
+    unsigned long spiTransactions;
+    // Times CE went active.
+    unsigned long strobes;
+    unsigned long chipReads;
+    unsigned long chipWrites;
+    unsigned long powerCycles;
+    // Times the chip and the MCU ended up driving the data bus at once.
+    // Should always be 0!
+    unsigned long busContentions;
+};
+
+class Simulator
+{
+public:
+    // Starts over with fresh registers, a new chip and zeroed counters.
+    void reset(const SimulatorWiring& wiring, const SimulatedChip& chip);
+    void resetCounters();
+
+    SimulatorCounters counters;
+
+    // The chip's contents, straight from the source.
+    uint8_t* memory() {return _memory.data();}
+    uint32_t size() {return _chip.size;}
+    uint32_t latchedAddress() {return _latchedAddress;}
+
+    void onRegisterWrite(SimRegister& reg, uint8_t oldValue);
+    void onTimePassing();
+private:
+    SimulatorWiring _wiring;
+    SimulatedChip _chip;
+    std::vector<uint8_t> _memory;
+    uint32_t _noiseState;
+
+    uint32_t _shiftRegister;
+    uint32_t _latchedAddress;
+    bool _latch;
+    bool _isPowered;
+    unsigned long _poweredOffAt;
+    unsigned long _poweredOnAt;
+    bool _ceActive;
+    unsigned long _ceActiveAt;
+    // Whether the current strobe came too early after powering on.
+    bool _isIgnoringStrobe;
+
+    // The EEPROM's page buffer, software data protection and write cycle.
+    std::vector<uint8_t> _pageData;
+    std::vector<bool> _isPageByteLoaded;
+    uint32_t _pageAddress;
+    bool _isLoadingPage;
+    unsigned long _lastLoadAt;
+    uint8_t _lastLoadedByte;
+    bool _isWriteCycleRunning;
+    unsigned long _writeCycleStartedAt;
+    bool _toggleBit;
+    bool _isDataProtected;
+    bool _isUnlocked;
+    uint8_t _commandStep;
+    std::vector<std::pair<uint32_t, uint8_t>> _commandBytes;
+    bool _isWriting;
+    bool _isDriving;
+    bool _isContending;
+
+    void _update();
+    bool _isAccessDone();
+    void _writeChip(uint32_t address, uint8_t value);
+    void _loadEepromByte(uint32_t address, uint8_t value);
+    void _loadPageByte(uint32_t address, uint8_t value);
+    void _startWriteCycle();
+    bool _isEepromBusy();
+    void _updateInputs();
+    void _fillWithNoise();
+    bool _isDataRegister(SimRegister& reg);
+    bool _isOutput(uint8_t pin);
+    bool _outputLevel(uint8_t pin);
+    uint8_t _mcuBusValue();
+    uint32_t _chipAddress();
+    uint8_t _chipValue();
+};
+
+extern Simulator SIMULATOR;
+
+// A serial port with the host's side of it being plain old buffers.
+class SimulatedSerial : public Stream
+{
+public:
+    int available() override {return _input.size();}
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t n) override;
+    using Print::write;
+    // Never fills up, but says it's as big as HardwareSerial's buffer, so
+    // that reads send a bufferful at a time like on a real board.
+    int availableForWrite() override {return 64;}
+
+    void feed(uint8_t n) {_input.push_back(n);}
+    void feed(const uint8_t* data, size_t length);
+    void feedUint16(uint16_t n);
+    void feedUint32(uint32_t n);
+    void clear();
+    // Everything the firmware's written so far.
+    std::vector<uint8_t> output;
+private:
+    std::deque<uint8_t> _input;
+};
+
+#endif
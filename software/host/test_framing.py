@@ -0,0 +1,231 @@
+#!/usr/bin/env python3
+"""Runs framune.py against the firmware on the simulated board (framunesim),
+through a pty, with bytes getting garbled and lost along the way - and checks
+that reads and writes still come through intact, by sending frames again.
+
+    make test
+
+or, with framunesim already built:
+
+    python3 test_framing.py build/framunesim
+"""
+
+import os
+import pty
+import random
+import select
+import subprocess
+import sys
+import threading
+import tty
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import framune
+import serial
+
+# What comes before the frames: the command and its echo, the address, size
+# and encoding, and the size, window and encoding in reply.
+TO_DEVICE_HEADER_LENGTH = 1 + 1 + 4 + 4 + 1
+TO_HOST_HEADER_LENGTH = 1 + 4 + 1 + 1
+
+class NoisyLine(threading.Thread):
+    """Passes bytes between the pty and framunesim, garbling the ones at
+    the offsets given to inject."""
+
+    def __init__(self, master, simulator):
+        super().__init__(daemon=True)
+        self._master = master
+        self._simulator = simulator
+        self._lock = threading.Lock()
+        # Written to by stop(), so that run() wakes up and returns.
+        self._stop_in, self._stop_out = os.pipe()
+        self.inject()
+
+    def inject(self, to_device=(), to_host=()):
+        """From now on, flip a bit in (or with 'drop', leave out) the bytes
+        at these offsets, counted separately each way. Each is an
+        (offset, 'flip' or 'drop') pair."""
+        with self._lock:
+            self._faults = {True: dict(to_device), False: dict(to_host)}
+            self._counts = {True: 0, False: 0}
+            self.injected = 0
+
+    def passed(self, is_to_device):
+        """How many bytes have gone by that way since inject()."""
+        with self._lock:
+            return self._counts[is_to_device]
+
+    def _garble(self, is_to_device, data):
+        with self._lock:
+            faults = self._faults[is_to_device]
+            start = self._counts[is_to_device]
+            self._counts[is_to_device] += len(data)
+            garbled = bytearray()
+            for offset, n in enumerate(data, start):
+                fault = faults.pop(offset, None)
+                if fault:
+                    self.injected += 1
+                if fault == 'drop':
+                    continue
+                garbled.append(n ^ 0x10 if fault == 'flip' else n)
+            return bytes(garbled)
+
+    def stop(self):
+        """Stop passing bytes, before the pty or framunesim go away."""
+        os.write(self._stop_out, b'\0')
+        self.join()
+        os.close(self._stop_in)
+        os.close(self._stop_out)
+
+    def run(self):
+        device_out = self._simulator.stdout.fileno()
+        device_in = self._simulator.stdin.fileno()
+        while True:
+            try:
+                readable, _, _ = select.select(
+                    [self._master, device_out, self._stop_in], [], [])
+            except (OSError, ValueError):
+                return
+            if self._stop_in in readable:
+                return
+            for fd in readable:
+                is_to_device = fd == self._master
+                try:
+                    data = os.read(fd, 4096)
+                    if not data:
+                        return
+                    data = self._garble(is_to_device, data)
+                    os.write(device_in if is_to_device else self._master, data)
+                except (OSError, ValueError):
+                    return
+
+def frame_starts(address, data, header_length):
+    """Return where each frame of a transfer of `data` at `address` starts,
+    counting the header - they're as long as they compress to."""
+    first_address, count = framune.frame_span(address, len(data))
+    padded = bytes(address - first_address) + data
+    padded += bytes(count * framune.FRAME_SIZE - len(padded))
+    starts = [header_length]
+    for i in range(count):
+        payload = padded[i * framune.FRAME_SIZE:(i + 1) * framune.FRAME_SIZE]
+        starts.append(starts[-1] + len(framune.frame_bytes(i, payload, True)))
+    return starts
+
+failures = 0
+
+def check(condition, description):
+    global failures
+    if not condition:
+        print("    FAILED: " + description)
+        failures += 1
+
+def main(simulator_path):
+    simulator = subprocess.Popen([simulator_path], stdin=subprocess.PIPE,
+                                 stdout=subprocess.PIPE, bufsize=0)
+    master, slave = pty.openpty()
+    tty.setraw(slave)
+    line = NoisyLine(master, simulator)
+    line.start()
+    ser = serial.Serial(os.ttyname(slave), framune.BAUD_RATE,
+                        timeout=framune.MIN_TIMEOUT)
+    device = framune.Framune(ser)
+    try:
+        check(device.version_matches(), "the protocol versions don't match")
+        device.analyze()
+        check(device.chip.size == 32768, "analyzing found the wrong size")
+        device.get_stats()
+
+        rng = random.Random(23)
+        data = bytes(rng.getrandbits(8) for _ in range(32768))
+        # Random data doesn't compress, so these are all 64 bytes long.
+        to_device = frame_starts(0, data, TO_DEVICE_HEADER_LENGTH)
+        to_host = frame_starts(0, data, TO_HOST_HEADER_LENGTH)
+        print("Writing 32 KiB, with 5 bytes garbled and 1 lost")
+        line.inject(to_device=[
+            (to_device[5] + 30, 'flip'),
+            (to_device[40] + 2, 'flip'),
+            (to_device[41] + 71, 'flip'),
+            (to_device[100] + 50, 'drop'),
+            (to_device[300] + 10, 'flip'),
+            (to_device[450] + 1, 'flip')
+        ])
+        check(device.write(0, data) == len(data), "writing wrote too little")
+        check(line.injected == 6, "not all the faults got injected")
+
+        print("Reading 32 KiB, with 4 bytes garbled and 1 lost")
+        line.inject(to_host=[
+            (to_host[3] + 20, 'flip'),
+            (to_host[90], 'flip'),
+            (to_host[150] + 10, 'drop'),
+            (to_host[300] + 69, 'flip')
+        ], to_device=[
+            # An ACK, so the frame gets sent again after a timeout.
+            (TO_DEVICE_HEADER_LENGTH + 3 * 50 + 1, 'flip')
+        ])
+        check(device.read(0, len(data)) == data, "reading read the wrong data")
+        check(line.injected == 5, "not all the faults got injected")
+
+        print("Writing changes to 1000 bytes, with 1 byte garbled")
+        changed = bytearray(data[100:1100])
+        for i in (0, 1, 500, 999):
+            changed[i] ^= 0xFF
+        line.inject(to_device=[
+            (frame_starts(100, bytes(changed), TO_DEVICE_HEADER_LENGTH)[7] + 40,
+             'flip')
+        ])
+        check(device.write_changes(100, bytes(changed)) == (1000, 4),
+              "writing changes miscounted them")
+        line.inject()
+        check(device.read(100, 1000) == bytes(changed),
+              "writing changes wrote the wrong data")
+
+        # Mostly blank, like chips tend to be, so the frames get compressed
+        # down to a few bytes - and faults land in the compressed data.
+        blank = bytearray(b'\xFF' * len(data))
+        for address in range(0, len(blank), 1024):
+            blank[address:address + 14] = b'SAVE DATA v1.0'
+        blank = bytes(blank)
+        to_device = frame_starts(0, blank, TO_DEVICE_HEADER_LENGTH)
+        to_host = frame_starts(0, blank, TO_HOST_HEADER_LENGTH)
+        print("Writing 32 KiB of mostly blank data, with 2 bytes garbled and 1 lost")
+        line.inject(to_device=[
+            (to_device[5] + 4, 'flip'),
+            (to_device[16] + 6, 'flip'),
+            (to_device[200] + 3, 'drop')
+        ])
+        check(device.write(0, blank) == len(blank), "writing wrote too little")
+        check(line.injected == 3, "not all the faults got injected")
+        check(line.passed(True) < len(blank) // 4,
+              "writing didn't compress the data")
+
+        print("Reading 32 KiB of mostly blank data, with 2 bytes garbled")
+        line.inject(to_host=[
+            (to_host[10] + 4, 'flip'),
+            (to_host[400] + 5, 'flip')
+        ])
+        check(device.read(0, len(blank)) == blank, "reading read the wrong data")
+        check(line.injected == 2, "not all the faults got injected")
+        check(line.passed(False) < len(blank) // 4,
+              "reading didn't compress the data")
+
+        # (Unless framunesim's built without counters - but then, everything
+        # coming through intact says enough.)
+        stats = device.get_stats()
+        if stats is not None:
+            print("Frames resent: {}".format(stats['frames_resent']))
+            check(stats['frames_resent'] >= 12, "too few frames got sent again")
+    finally:
+        device.close()
+        line.stop()
+        os.close(master)
+        simulator.stdin.close()
+        simulator.wait()
+
+    if failures:
+        print("\n{} check(s) failed.".format(failures))
+        return 1
+    print("\nAll checks passed.")
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(*sys.argv[1:]))
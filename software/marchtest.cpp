@@ -0,0 +1,100 @@
+#include "marchtest.hpp"
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// The algorithms, in transparent form. Their textbook versions are in the
+// comments, with ⇑ for ascending, ⇓ for descending and ⇕ for either.
+
+// MATS+: {⇕(w0); ⇑(r0,w1); ⇓(r1,w0)}
+// The quickest one that still catches address decoder faults.
+static const MarchElement MATS_PLUS_ELEMENTS[] PROGMEM = {
+    {false, 2, {MARCH_R0, MARCH_W1}},
+    {true,  2, {MARCH_R1, MARCH_W0}}
+};
+
+// March C-: {⇕(w0); ⇑(r0,w1); ⇑(r1,w0); ⇓(r0,w1); ⇓(r1,w0); ⇕(r0)}
+// Adds transition faults and the unlinked coupling faults.
+static const MarchElement MARCH_C_MINUS_ELEMENTS[] PROGMEM = {
+    {false, 2, {MARCH_R0, MARCH_W1}},
+    {false, 2, {MARCH_R1, MARCH_W0}},
+    {true,  2, {MARCH_R0, MARCH_W1}},
+    {true,  2, {MARCH_R1, MARCH_W0}},
+    {false, 1, {MARCH_R0}}
+};
+
+// March SS: {⇕(w0); ⇑(r0,r0,w0,r0,w1); ⇑(r1,r1,w1,r1,w0);
+//            ⇓(r0,r0,w0,r0,w1); ⇓(r1,r1,w1,r1,w0); ⇕(r0)}
+// All of the simple static faults, read and write disturbances included.
+static const MarchElement MARCH_SS_ELEMENTS[] PROGMEM = {
+    {false, 5, {MARCH_R0, MARCH_R0, MARCH_W0, MARCH_R0, MARCH_W1}},
+    {false, 5, {MARCH_R1, MARCH_R1, MARCH_W1, MARCH_R1, MARCH_W0}},
+    {true,  5, {MARCH_R0, MARCH_R0, MARCH_W0, MARCH_R0, MARCH_W1}},
+    {true,  5, {MARCH_R1, MARCH_R1, MARCH_W1, MARCH_R1, MARCH_W0}},
+    {false, 1, {MARCH_R0}}
+};
+
+#define NUM_ELEMENTS(elements) (sizeof(elements) / sizeof(*(elements)))
+
+// In MarchAlgorithmId order.
+static const MarchAlgorithm MARCH_ALGORITHMS[] PROGMEM = {
+    {
+        NUM_ELEMENTS(MATS_PLUS_ELEMENTS), MATS_PLUS_ELEMENTS,
+        MARCH_FAULT_STUCK_AT | MARCH_FAULT_ADDRESS_DECODER
+    },
+    {
+        NUM_ELEMENTS(MARCH_C_MINUS_ELEMENTS), MARCH_C_MINUS_ELEMENTS,
+        MARCH_FAULT_STUCK_AT | MARCH_FAULT_TRANSITION |
+        MARCH_FAULT_ADDRESS_DECODER | MARCH_FAULT_INVERSION_COUPLING |
+        MARCH_FAULT_IDEMPOTENT_COUPLING | MARCH_FAULT_STATE_COUPLING
+    },
+    {
+        NUM_ELEMENTS(MARCH_SS_ELEMENTS), MARCH_SS_ELEMENTS,
+        MARCH_FAULT_STUCK_AT | MARCH_FAULT_TRANSITION |
+        MARCH_FAULT_ADDRESS_DECODER | MARCH_FAULT_INVERSION_COUPLING |
+        MARCH_FAULT_IDEMPOTENT_COUPLING | MARCH_FAULT_STATE_COUPLING |
+        MARCH_FAULT_READ_DESTRUCTIVE | MARCH_FAULT_DECEPTIVE_READ_DESTRUCTIVE |
+        MARCH_FAULT_INCORRECT_READ | MARCH_FAULT_WRITE_DISTURB
+    }
+};
+
+bool getMarchAlgorithm(uint8_t id, MarchAlgorithm* algorithm)
+{
+    if (id >= MARCH_NUM_ALGORITHMS) {
+        return false;
+    }
+    memcpy_P(algorithm, &MARCH_ALGORITHMS[id], sizeof(MarchAlgorithm));
+    return true;
+}
+
+void getMarchElement(const MarchAlgorithm& algorithm, uint8_t i,
+                     MarchElement* element)
+{
+    memcpy_P(element, &algorithm.elements[i], sizeof(MarchElement));
+}
+
+uint8_t marchOperationsPerCell(const MarchAlgorithm& algorithm)
+{
+    uint8_t operations = 1;
+    for (uint8_t i = 0; i < algorithm.numElements; i++) {
+        MarchElement element;
+        getMarchElement(algorithm, i, &element);
+        operations += element.numOperations;
+    }
+    return operations;
+}
+
+uint32_t marchSignatureOf(uint32_t address, uint8_t value)
+{
+    // The signatures are sums, so that the order of the reads doesn't
+    // matter. Which means this has to mix the address and value together
+    // well enough that two wrong reads are very unlikely to cancel out.
+    // This is MurmurHash3's finalizer.
+    uint32_t x = (address << 8) ^ value;
+    x ^= x >> 16;
+    x *= 0x85EBCA6BUL;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35UL;
+    x ^= x >> 16;
+    return x;
+}
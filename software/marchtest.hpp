@@ -0,0 +1,119 @@
+#ifndef MARCHTEST_HPP
+#define MARCHTEST_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// March tests! The classic way of testing RAM: a list of "elements", each of
+// which marches through every cell in ascending or descending order, doing
+// the same few reads and writes on each cell before moving on to the next.
+// The order of the elements and operations is what decides which faults get
+// caught - stuck bits, bits that can't flip one way, broken address decoders,
+// cells that disturb other cells, and so on.
+//
+// Textbook march tests write 0s and 1s, destroying whatever's on the chip.
+// These are the "transparent" versions instead: 0 means a cell's original
+// contents and 1 their complement, and the initial write-0 element is left
+// out. Since every cell gets flipped an even number of times, the chip ends
+// up just the way it started - without having to save anything.
+//
+// That leaves the question of how to check a read when the cell's original
+// contents were never saved. Within an element, that's easy: once the first
+// read of a cell is done, what the rest of the element's reads should return
+// is known, so they're checked on the spot. The first reads of each element
+// can't be, so they're summed up into a signature instead. Before the first
+// element, there's one extra read-only pass over the cells, which works out
+// what every element's signature should be - the signature doesn't depend
+// on the order the cells are read in, so that's all it takes. A signature
+// mismatch says which element saw something wrong, but not where.
+//
+// The operations work on whole bytes at a time, so faults between bits of
+// the same byte are only caught where the chip's own data happens to make
+// them show up. Nothing's perfect!
+
+// The fault models an algorithm detects, as bit flags.
+enum MarchFault : uint16_t
+{
+    MARCH_FAULT_STUCK_AT = 1 << 0,
+    MARCH_FAULT_TRANSITION = 1 << 1,
+    MARCH_FAULT_ADDRESS_DECODER = 1 << 2,
+    MARCH_FAULT_INVERSION_COUPLING = 1 << 3,
+    MARCH_FAULT_IDEMPOTENT_COUPLING = 1 << 4,
+    MARCH_FAULT_STATE_COUPLING = 1 << 5,
+    MARCH_FAULT_READ_DESTRUCTIVE = 1 << 6,
+    MARCH_FAULT_DECEPTIVE_READ_DESTRUCTIVE = 1 << 7,
+    MARCH_FAULT_INCORRECT_READ = 1 << 8,
+    MARCH_FAULT_WRITE_DISTURB = 1 << 9
+};
+
+// 0 is a cell's original contents, and 1 is their complement.
+enum MarchOperation : uint8_t
+{
+    MARCH_R0,
+    MARCH_R1,
+    MARCH_W0,
+    MARCH_W1
+};
+
+inline bool isMarchWrite(MarchOperation operation)
+{
+    return operation == MARCH_W0 || operation == MARCH_W1;
+}
+
+#define MARCH_MAX_OPERATIONS 5
+
+// Every element has to start with a read.
+struct MarchElement
+{
+    bool isDescending;
+    uint8_t numOperations;
+    MarchOperation operations[MARCH_MAX_OPERATIONS];
+};
+
+struct MarchAlgorithm
+{
+    uint8_t numElements;
+    const MarchElement* elements; // In PROGMEM.
+    uint16_t coverage; // MarchFault flags.
+};
+
+// These numbers are what's sent over serial, so don't reorder them.
+enum MarchAlgorithmId : uint8_t
+{
+    MARCH_MATS_PLUS,
+    MARCH_C_MINUS,
+    MARCH_SS,
+    MARCH_NUM_ALGORITHMS
+};
+
+// What the button test and MemoryChip::addressesWorkBetween use.
+#ifndef MARCH_TEST_DEFAULT_ALGORITHM
+#define MARCH_TEST_DEFAULT_ALGORITHM MARCH_C_MINUS
+#endif
+
+struct MarchTestResult
+{
+    bool passed;
+    // Reads that didn't match what was written or read just before at the
+    // same address, and the first address that happened at.
+    uint32_t mismatches;
+    uint32_t firstMismatchAddress;
+    // Bit n is set if element n's first reads didn't add up to the chip's
+    // original contents.
+    uint16_t failedElements;
+};
+
+// Called every so often during a test, for "still working!" animations.
+typedef void (*MarchTestProgressCallback)();
+
+// Returns false if there's no such algorithm.
+bool getMarchAlgorithm(uint8_t id, MarchAlgorithm* algorithm);
+void getMarchElement(const MarchAlgorithm& algorithm, uint8_t i,
+                     MarchElement* element);
+// Reads and writes per cell, the read-only first pass included - how long
+// the algorithm takes, more or less.
+uint8_t marchOperationsPerCell(const MarchAlgorithm& algorithm);
+// What a read of value at address adds to an element's signature.
+uint32_t marchSignatureOf(uint32_t address, uint8_t value);
+
+#endif
@@ -1,71 +1,85 @@
-#include "memorychip.hpp"
-
 #include <stdint.h>
+#include <Arduino.h>
+
+#ifdef INCLUDING_MEMORYCHIP_TEMPLATES
+// Template implementations.
+
 #include "fastpins.hpp"
 
 // A little warning for you: to maximize speed, the read and write functions
 // don't verify that the pins are in the correct mode - make sure to manage
 // switchToReadMode and switchToWriteMode properly.
 
-MemoryChip::MemoryChip(OutputChannel<uint16_t>* addressChannel,
-                       InputOutputChannel<uint8_t>* dataChannel,
-                       unsigned int cePin, unsigned int oePin,
-                       unsigned int wePin, unsigned int powerPin,
-                       uint8_t powerPinOnState) :
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::BasicMemoryChip(
+    AddressChannelType* addressChannel, DataChannelType* dataChannel,
+    ControlPinsType controlPins, uint8_t powerPinOnState) :
     _addressChannel(addressChannel), _dataChannel(dataChannel),
-    _cePin(pinToPortInfo(cePin)), _oePin(pinToPortInfo(oePin)),
-    _wePin(pinToPortInfo(wePin)), _powerPin(pinToPortInfo(powerPin)),
-    _powerPinOnState(powerPinOnState) {}
+    _pins(controlPins), _powerPinOnState(powerPinOnState) {}
 
-void MemoryChip::initPins()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::BasicMemoryChip(
+    AddressChannelType* addressChannel, DataChannelType* dataChannel,
+    unsigned int cePin, unsigned int oePin,
+    unsigned int wePin, unsigned int powerPin,
+    uint8_t powerPinOnState) :
+    _addressChannel(addressChannel), _dataChannel(dataChannel),
+    _pins(cePin, oePin, wePin, powerPin), _powerPinOnState(powerPinOnState) {}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::initPins()
 {
     _addressChannel->initOutput();
+    // Whatever the pins were before, they need setting up now.
+    _busMode = BusMode::UNKNOWN;
     switchToReadMode();
 
     // It's important that these pins immediately
     // start high, so the chip isn't enabled!
-    SET_BITS_IN_PORT_HIGH(_cePin.out, _cePin.bitMask);
-    pinMode(_cePin.pin, OUTPUT);
-    SET_BITS_IN_PORT_HIGH(_oePin.out, _oePin.bitMask);
-    pinMode(_oePin.pin, OUTPUT);
-    SET_BITS_IN_PORT_HIGH(_wePin.out, _wePin.bitMask);
-    pinMode(_wePin.pin, OUTPUT);
+    _pins.ce.setHigh();
+    _pins.ce.setOutput();
+    _pins.oe.setHigh();
+    _pins.oe.setOutput();
+    _pins.we.setHigh();
+    _pins.we.setOutput();
 
     powerOff();
-    pinMode(_powerPin.pin, OUTPUT);
+    _pins.power.setOutput();
 }
 
-bool MemoryChip::getIsOn()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::getIsOn()
 {
     return _isOn;
 }
 
-void MemoryChip::powerOff()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::powerOff()
 {
     if (_powerPinOnState == HIGH) {
         // If the power is on high, that means a low-side switching circuit
         // is used, which means ground is being cut off. When ground is cut
         // off, to cut power to the chip, all other lines need to be high.
-        _addressChannel->output(0xFFFF);
-        if (_inWriteMode) {
+        _addressChannel->output(static_cast<Address>(~static_cast<Address>(0)));
+        if (_busMode == BusMode::WRITE) {
             _dataChannel->output(0xFF);
         }
-        SET_BITS_IN_PORT_LOW(_powerPin.out, _powerPin.bitMask);
+        _pins.power.setLow();
     } else {
         // If the power is on high, that means a high-side switching circuit
         // is used, which means V+ is being cut off. When V+ is cut
         // off, to cut power to the chip, all other lines need to be low.
         _addressChannel->output(0);
-        if (_inWriteMode) {
+        if (_busMode == BusMode::WRITE) {
             _dataChannel->output(0);
         }
-        SET_BITS_IN_PORT_LOW(_oePin.out, _oePin.bitMask);
-        SET_BITS_IN_PORT_LOW(_wePin.out, _wePin.bitMask);
-        SET_BITS_IN_PORT_HIGH(_powerPin.out, _powerPin.bitMask);
+        _pins.oe.setLow();
+        _pins.we.setLow();
+        _pins.power.setHigh();
         // CE needs to go low last, since asserting CE low activates the chip.
         // By eliminating the last source of positive voltage with CE, we
         // minimize the risk of accidentally writing to the chip on power off.
-        SET_BITS_IN_PORT_LOW(_cePin.out, _cePin.bitMask);
+        _pins.ce.setLow();
     }
     _isOn = false;
     /*
@@ -87,19 +101,21 @@ void MemoryChip::powerOff()
     delayMicroseconds(5);
 }
 
-void MemoryChip::powerOn()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::powerOn()
 {
     if (_powerPinOnState == HIGH) {
-        SET_BITS_IN_PORT_HIGH(_powerPin.out, _powerPin.bitMask);
+        _pins.power.setHigh();
     } else {
         // For the same reason outlined in powerOff,
         // CE needs to go high before the V+ line does.
-        SET_BITS_IN_PORT_HIGH(_cePin.out, _cePin.bitMask);
-        SET_BITS_IN_PORT_LOW(_powerPin.out, _powerPin.bitMask);
-        SET_BITS_IN_PORT_HIGH(_oePin.out, _oePin.bitMask);
-        SET_BITS_IN_PORT_HIGH(_wePin.out, _wePin.bitMask);
+        _pins.ce.setHigh();
+        _pins.power.setLow();
+        _pins.oe.setHigh();
+        _pins.we.setHigh();
     }
     _isOn = true;
+    STATS_COUNT(STATS_POWER_CYCLES);
     /*
         This should theoretically just be the MOSFET switching time,
         as in powerOff, but... apparently, some FM18W08s consistently take
@@ -112,40 +128,61 @@ void MemoryChip::powerOn()
         in a certain batch, and perhaps even all chips from a certain factory.
         The ~130 µs limit has even been observed in at least two batches from
         different sellers! Beyond that, though, the chips seem to be fine.
-        The figure of 180 µs was arbitrarily chosen for some leeway.
+        The figure of 180 µs (MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS)
+        was arbitrarily chosen for some leeway.
 
-        If this turns out to be significant somehow, a test can of course be
-        devised for it that tests operation both with and without the extra
-        delay. Just make sure to test with it first - otherwise, the byte(s)
-        tested will be irreversibly overwritten.
+        Since most chips don't need any of that, analyze calibrates it for
+        the chip at hand - see _calibratePowerOnSettleMicros. That saves the
+        byte it tests with first, with the default delay, since otherwise it'd
+        be irreversibly overwritten.
     */
-    delayMicroseconds(180);
+    if (_properties.powerOnSettleMicros) {
+        delayMicroseconds(_properties.powerOnSettleMicros);
+    }
 }
 
-void MemoryChip::getProperties(MemoryChipKnownProperties* knownProperties,
-                               MemoryChipProperties* properties)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::getProperties(
+    MemoryChipKnownProperties* knownProperties,
+    MemoryChipProperties* properties)
 {
     *knownProperties = _knownProperties;
     *properties = _properties;
 }
 
-void MemoryChip::setProperties(const MemoryChipKnownProperties* knownProperties,
-                               const MemoryChipProperties* properties)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::setProperties(
+    const MemoryChipKnownProperties* knownProperties,
+    const MemoryChipProperties* properties)
 {
     _knownProperties = *knownProperties;
     _properties = *properties;
 }
 
-void MemoryChip::analyzeUnknownProperties()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::analyzeUnknownProperties()
 {
     // A decidedly non-operational chip doesn't have any properties, yo!
     if (_knownProperties.isOperational && !_properties.isOperational) {
-        _knownProperties = {true, false, false, false};
-        _properties = {false, 0, false, false};
+        _knownProperties = {true, false, false, false, false, false, false};
+        _properties = {
+            false, 0, false, false, MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS, 0, false
+        };
         return;
     }
 
-    bool wasInWriteMode = _inWriteMode;
+    bool wasInWriteMode = _busMode == BusMode::WRITE;
+
+    // Until the timings are calibrated, the chip gets the safe ones, so that
+    // a slow chip isn't mistaken for a broken one. It might well have been
+    // powered on with some other chip's settle time just now, too.
+    if (!_knownProperties.strobeMicros) {
+        _properties.strobeMicros = MEMORY_CHIP_MAX_STROBE_MICROS;
+    }
+    if (!_knownProperties.powerOnSettleMicros) {
+        _properties.powerOnSettleMicros = MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS;
+        delayMicroseconds(MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS);
+    }
 
     // This'll overwrite a "known" isOperational if it's set to true, but that
     // only makes sense - in testing isSlow, isOperational has to be tested,
@@ -153,21 +190,30 @@ void MemoryChip::analyzeUnknownProperties()
     // nor slow works, we can't give isSlow a meaningful value, and we know
     // the chip isn't operational). It does, however, preserve a "known"
     // isSlow even if it tests OK for fast operation.
-    if (!_knownProperties.isOperational || !_knownProperties.isSlow) {
-        if (_testAddress(0, _knownProperties.isSlow && _properties.isSlow)) {
+    if (!_knownProperties.isOperational || !_knownProperties.isSlow ||
+        !_knownProperties.usesDataProtection) {
+        bool isKnownSlow = _knownProperties.isSlow && _properties.isSlow;
+        if (!isKnownSlow && _testAddress(0, false)) {
             _knownProperties.isOperational = true;
             _properties.isOperational = true;
             _knownProperties.isSlow = true;
-            _properties.isSlow = _knownProperties.isSlow && _properties.isSlow;
-        } else if (!_knownProperties.isSlow && _testAddress(0, true)) {
+            _properties.isSlow = false;
+            // Only slow chips have data protection to speak of.
+            if (!_knownProperties.usesDataProtection) {
+                _knownProperties.usesDataProtection = true;
+                _properties.usesDataProtection = false;
+            }
+        } else if ((isKnownSlow || !_knownProperties.isSlow) && _testSlowAddress(0)) {
             _knownProperties.isOperational = true;
             _properties.isOperational = true;
             _knownProperties.isSlow = true;
             _properties.isSlow = true;
         } else {
             // Neither a fast test nor a slow test worked.
-            _knownProperties = {true, false, false, false};
-            _properties = {false, 0, false, false};
+            _knownProperties = {true, false, false, false, false, false, false};
+            _properties = {
+                false, 0, false, false, MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS, 0, false
+            };
             if (wasInWriteMode) {
                 switchToWriteMode();
             } else {
@@ -177,6 +223,19 @@ void MemoryChip::analyzeUnknownProperties()
         }
     }
 
+    // Before the other tests, so that they run at the chip's own speed.
+    // On slow chips, writeByte waits out each write, so this works for those
+    // just the same - and an EEPROM's power-up write inhibit is exactly the
+    // kind of thing the settle time is for.
+    if (!_knownProperties.strobeMicros) {
+        _knownProperties.strobeMicros = true;
+        _calibrateStrobeMicros();
+    }
+    if (!_knownProperties.powerOnSettleMicros) {
+        _knownProperties.powerOnSettleMicros = true;
+        _calibratePowerOnSettleMicros();
+    }
+
     if (!_knownProperties.size) {
         uint32_t size = _testSize();
         if (size != 0) {
@@ -198,27 +257,183 @@ void MemoryChip::analyzeUnknownProperties()
     }
 }
 
-void MemoryChip::analyze()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::analyze()
 {
-    _knownProperties = {false, false, false, false};
-    _properties = {false, 0, false, false};
+    _knownProperties = {false, false, false, false, false, false, false};
+    _properties = {
+        false, 0, false, false, MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS, 0, false
+    };
     analyzeUnknownProperties();
 }
 
-bool MemoryChip::_testAddress(uint16_t address, bool slow)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_testAddress(
+    Address address, bool slow)
 {
-    (void) slow; // TODO: Implement EEPROM speed.
+    // On a slow chip, writes wait for themselves to finish. The test byte
+    // always differs from what was there by half its bits - and with no chip
+    // (so, pulled-up 0xFFs), it's 0xA5, whose top bit doesn't keep an EEPROM
+    // write's polling waiting for a chip that isn't there.
+    bool wasSlow = _properties.isSlow;
+    _properties.isSlow = slow;
+    switchToReadMode();
+    uint8_t readBack;
+    uint8_t prevByte = readModifyWriteByte(address, 0xFF, 0x5A, &readBack);
+    uint8_t testByte = prevByte ^ 0x5A;
+    switchToWriteMode();
+    writeByte(address, prevByte);
+    if (readBack != testByte && !slow) {
+        // An EEPROM takes the test byte all the same, and is then too busy
+        // writing it to take prevByte back. Wait for it, and put prevByte
+        // back the slow way, so as not to leave it overwritten.
+        delay(MEMORY_CHIP_SLOW_WRITE_CYCLE_MILLIS);
+        _properties.isSlow = true;
+        writeByte(address, prevByte);
+    }
+    _properties.isSlow = wasSlow;
+    return readBack == testByte;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_testSlowAddress(
+    Address address)
+{
+    // An EEPROM with software data protection on ignores writes that don't
+    // come with the unlock sequence, so unless it's known whether it's on,
+    // try both ways. Without it first, so as not to turn it on uninvited.
+    for (uint8_t usesDataProtection = 0; usesDataProtection < 2; usesDataProtection++) {
+        if (_knownProperties.usesDataProtection &&
+            _properties.usesDataProtection != usesDataProtection) {
+            continue;
+        }
+        _properties.usesDataProtection = usesDataProtection;
+        if (_testAddress(address, true)) {
+            _knownProperties.usesDataProtection = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Adds MEMORY_CHIP_TIMING_MARGIN_PERCENT to a calibrated time, rounding up.
+static inline uint16_t withTimingMargin(uint16_t micros, uint16_t maxMicros)
+{
+    uint32_t withMargin = micros +
+        (static_cast<uint32_t>(micros) * MEMORY_CHIP_TIMING_MARGIN_PERCENT + 99) / 100;
+    return withMargin < maxMicros ? withMargin : maxMicros;
+}
 
+// A few addresses within even the smallest chip, between them flipping
+// every one of its address lines.
+static inline uint8_t timingTestAddress(uint8_t trial)
+{
+    return trial * 0x55;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_calibrateStrobeMicros()
+{
+    // The bytes get saved with the strobes that are known to work (see
+    // analyzeUnknownProperties), since the ones tried here are going to
+    // mangle them.
+    uint8_t prevBytes[MEMORY_CHIP_TIMING_TRIALS];
     switchToReadMode();
-    uint8_t prevByte = readByte(0);
-    uint8_t testByte = prevByte == 0xA5 ? 0x5A : 0xA5;
+    for (uint8_t i = 0; i < MEMORY_CHIP_TIMING_TRIALS; i++) {
+        prevBytes[i] = readByte(timingTestAddress(i));
+    }
+
+    // Every strobe time gets a different test byte than the one before, so
+    // that a write that didn't happen can't read back as one that did.
+    uint8_t strobeMicros = 0;
+    for (; strobeMicros < MEMORY_CHIP_MAX_STROBE_MICROS; strobeMicros++) {
+        _properties.strobeMicros = strobeMicros;
+        uint8_t flip = strobeMicros & 1 ? 0x55 : 0xAA;
+        bool works = true;
+        for (uint8_t i = 0; works && i < MEMORY_CHIP_TIMING_TRIALS; i++) {
+            switchToWriteMode();
+            writeByte(timingTestAddress(i), prevBytes[i] ^ flip);
+            switchToReadMode();
+            works = readByte(timingTestAddress(i)) == (prevBytes[i] ^ flip);
+        }
+        if (works) {
+            break;
+        }
+    }
+    _properties.strobeMicros = withTimingMargin(
+        strobeMicros, MEMORY_CHIP_MAX_STROBE_MICROS
+    );
+
     switchToWriteMode();
-    writeByte(address, testByte);
+    for (uint8_t i = 0; i < MEMORY_CHIP_TIMING_TRIALS; i++) {
+        writeByte(timingTestAddress(i), prevBytes[i]);
+    }
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_settlesWithin(
+    uint16_t settleMicros, Address address, uint8_t testByte)
+{
+    uint16_t prevSettleMicros = _properties.powerOnSettleMicros;
+    _properties.powerOnSettleMicros = settleMicros;
+    bool settles = true;
+    for (uint8_t i = 0; settles && i < MEMORY_CHIP_TIMING_TRIALS; i++) {
+        // Flipped every time, same as with the strobes.
+        testByte = ~testByte;
+        switchToReadMode();
+        _powerOffFor(MEMORY_CHIP_TIMING_OFF_MICROS);
+        switchToWriteMode();
+        writeByte(address, testByte);
+        switchToReadMode();
+        settles = readByte(address) == testByte;
+    }
+    _properties.powerOnSettleMicros = prevSettleMicros;
+    return settles;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_calibratePowerOnSettleMicros()
+{
+    // Saved with the settle time the chip was powered on with, which works.
+    const Address address = 0;
     switchToReadMode();
-    uint8_t readBack = readByte(address);
+    uint8_t prevByte = readByte(address);
+    uint8_t testByte = prevByte == 0xA5 ? 0x5A : 0xA5;
+
+    // Power cycles take a while, so rather than trying every settle time,
+    // this doubles it until it works, and then narrows it down between
+    // that and the last one that didn't.
+    uint16_t settleMicros = 0;
+    if (!_settlesWithin(0, address, testByte)) {
+        uint16_t tooShort = 0;
+        settleMicros = 1;
+        while (settleMicros < MEMORY_CHIP_MAX_POWER_ON_SETTLE_MICROS &&
+               !_settlesWithin(settleMicros, address, testByte)) {
+            tooShort = settleMicros;
+            settleMicros *= 2;
+        }
+        if (settleMicros >= MEMORY_CHIP_MAX_POWER_ON_SETTLE_MICROS) {
+            // Works or not, that's as long as it's getting.
+            settleMicros = MEMORY_CHIP_MAX_POWER_ON_SETTLE_MICROS;
+        } else {
+            while (settleMicros - tooShort > 1) {
+                uint16_t between = tooShort + (settleMicros - tooShort) / 2;
+                if (_settlesWithin(between, address, testByte)) {
+                    settleMicros = between;
+                } else {
+                    tooShort = between;
+                }
+            }
+        }
+    }
+    _properties.powerOnSettleMicros = withTimingMargin(
+        settleMicros, MEMORY_CHIP_MAX_POWER_ON_SETTLE_MICROS
+    );
+
+    // The last try might have been too short, so this is a fresh start.
+    _powerOffFor(MEMORY_CHIP_TIMING_OFF_MICROS);
     switchToWriteMode();
     writeByte(address, prevByte);
-    return readBack == testByte;
 }
 
 template <class T>
@@ -232,19 +447,21 @@ bool inArray(T arr[], size_t length, T element)
     return false;
 }
 
-uint32_t MemoryChip::_testSize()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint32_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_testSize()
 {
     // We need to make sure that the byte we try writing isn't already at any
     // of the lower addresses we're going to check - otherwise the size could
     // be determined incorrectly depending on the data on the chip.
     switchToReadMode();
-    uint8_t forbiddenTestBytes[MEMORY_CHIP_POSSIBLE_MIRRORS];
-    const uint32_t maxAddress = (
-        static_cast<uint32_t>(1) << MEMORY_CHIP_MAX_ADDRESS_WIDTH
-    ) - 1;
+    // One read and one check per possible address width, so even a 24-bit
+    // address channel only costs a few dozen accesses.
+    const uint8_t possibleMirrors = addressWidth() - MEMORY_CHIP_MIN_ADDRESS_WIDTH + 1;
+    uint8_t forbiddenTestBytes[MEMORY_CHIP_MAX_ADDRESS_WIDTH - MEMORY_CHIP_MIN_ADDRESS_WIDTH + 1];
+    const uint32_t maxAddress = (static_cast<uint32_t>(1) << addressWidth()) - 1;
     uint32_t testAddress = maxAddress;
     uint8_t prevByte = readByte(testAddress);
-    for (int i = 0; i < MEMORY_CHIP_POSSIBLE_MIRRORS; i++) {
+    for (int i = 0; i < possibleMirrors; i++) {
         // The very highest test address won't be checked.
         testAddress >>= 1;
         forbiddenTestBytes[i] = readByte(testAddress);
@@ -252,7 +469,7 @@ uint32_t MemoryChip::_testSize()
 
     uint8_t testByte = 0x5A;
     while (inArray<uint8_t>(
-        forbiddenTestBytes, MEMORY_CHIP_POSSIBLE_MIRRORS, testByte
+        forbiddenTestBytes, possibleMirrors, testByte
     )) {
         testByte++;
     }
@@ -263,7 +480,7 @@ uint32_t MemoryChip::_testSize()
     // Checks the address width under the minimum address width too, to make
     // sure there aren't mirrored bytes below that too.
     switchToReadMode();
-    for (int i = 0; i < MEMORY_CHIP_POSSIBLE_MIRRORS; i++) {
+    for (int i = 0; i < possibleMirrors; i++) {
         testAddress >>= 1;
         if (readByte(testAddress) != testByte) {
             // Once again, we're in, we're out again, and no one gets hurt.
@@ -279,67 +496,166 @@ uint32_t MemoryChip::_testSize()
     return 0;
 }
 
-bool MemoryChip::_testNonVolatility()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_testNonVolatility()
 {
-    // Gotta fit in the MCU's RAM! 512 bytes is 1/4 of the Atmega328P's RAM,
-    // so... if this ends up being too much, dial it down a bit.
-    uint16_t testLength;
-    if (_knownProperties.size && _properties.size < 512) {
-        testLength = _knownProperties.size;
-    } else {
-        testLength = 512;
-    }
-    testLength = _properties.size < testLength ? _properties.size : testLength;
-    uint8_t* prevBytes = new uint8_t[testLength];
+    // Transparent, like the march tests: rather than saving the sampled
+    // cells and writing a pattern over them, they get complemented in
+    // place, and signatures of what they held tell whether they've held on.
+    // So no buffer's needed, and the sample can be as big as it likes.
+    // (measureRetention does need one, since it counts how many cells
+    // decayed.) Since cells tend to decay toward whatever they power up as,
+    // which might just be their complement, they get complemented again
+    // after every power cycle - each cell spends one of every two away from
+    // its power-up value, whatever it is. Except on slow chips - those are
+    // EEPROMs, which are non-volatile by nature, and whose writes are too
+    // slow (and wear them too much) to spend on every step.
+    uint32_t size = _knownProperties.size && _properties.size ?
+                    _properties.size :
+                    static_cast<uint32_t>(1) << MEMORY_CHIP_MIN_ADDRESS_WIDTH;
+    uint32_t numSamples = size < MEMORY_CHIP_RETENTION_SAMPLES ?
+                          size : MEMORY_CHIP_RETENTION_SAMPLES;
+    uint32_t stride = size / numSamples;
 
-    // Could be sped up by using a WE-controlled write to switch the bytes
-    // as opposed to doing separate reads and writes, but... that'd
-    // be some real #PrematureOptimization.
+    beginBlock();
     switchToReadMode();
-    readBytes(0, prevBytes, testLength);
-    switchToWriteMode();
-    for (uint16_t address = 0; address < testLength; address++) {
-        writeByte(address, 0x22); // Extremely arbitrarily chosen value!
+    // Of the original contents, and of their complement.
+    uint32_t expectedSignatures[2] = {0, 0};
+    for (uint32_t i = 0; i < numSamples; i++) {
+        uint8_t n = readModifyWriteByte(i * stride, 0xFF, 0xFF, NULL);
+        expectedSignatures[0] += marchSignatureOf(i * stride, n);
+        expectedSignatures[1] += marchSignatureOf(i * stride, ~n);
     }
+    endBlock();
+    bool isComplemented = true;
 
-    powerOff();
-    // On the SRAM chip I tested this with, 10 milliseconds was enough for most
-    // of the data to have been reliably lost (~416 / 512 bytes). This might be
-    // different for other SRAM chips, though, so it may need to be dialed up...
-    delay(10);
-    powerOn();
-    
-    switchToReadMode();
-    bool isNonVolatile = true;
-    for (uint16_t address = 0; address < testLength; address++) {
-        if (readByte(address) != 0x22) {
-            isNonVolatile = false;
-            break;
+    bool decayed = false;
+    for (uint8_t step = 0; !decayed && step < MEMORY_CHIP_RETENTION_STEPS; step++) {
+        _powerOffFor(static_cast<uint32_t>(MEMORY_CHIP_RETENTION_MIN_OFF_MICROS)
+                     << (2 * step));
+        beginBlock();
+        switchToReadMode();
+        uint32_t signature = 0;
+        for (uint32_t i = 0; i < numSamples; i++) {
+            uint8_t n = _properties.isSlow ?
+                        readByte(i * stride) :
+                        readModifyWriteByte(i * stride, 0xFF, 0xFF, NULL);
+            signature += marchSignatureOf(i * stride, n);
+        }
+        endBlock();
+        decayed = signature != expectedSignatures[isComplemented];
+        if (!_properties.isSlow) {
+            isComplemented = !isComplemented;
+        }
+    }
+
+    // It's like we were never there. (Or, for cells that did decay, like
+    // their data was lost with the power - which it was.)
+    if (isComplemented) {
+        beginBlock();
+        switchToReadMode();
+        for (uint32_t i = 0; i < numSamples; i++) {
+            readModifyWriteByte(i * stride, 0xFF, 0xFF, NULL);
         }
+        endBlock();
+    }
+    return !decayed;
+}
+
+// Alternating, since cells tend to decay toward whatever they power up as,
+// and that could be a 0 or a 1.
+static inline uint8_t retentionPattern(uint16_t i)
+{
+    return i & 1 ? 0xAA : 0x55;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint16_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::measureRetention(
+    MemoryChipRetentionPoint points[MEMORY_CHIP_RETENTION_STEPS])
+{
+    // Gotta fit in the MCU's RAM! See scratch.hpp for how big this is.
+    uint8_t* prevBytes = borrowScratchBuffer();
+    if (!prevBytes) {
+        return 0;
     }
+    uint32_t size = _knownProperties.size && _properties.size ?
+                    _properties.size :
+                    static_cast<uint32_t>(1) << MEMORY_CHIP_MIN_ADDRESS_WIDTH;
+    uint16_t numSamples = MEMORY_CHIP_RETENTION_SAMPLES < SCRATCH_BUFFER_SIZE ?
+                          MEMORY_CHIP_RETENTION_SAMPLES : SCRATCH_BUFFER_SIZE;
+    numSamples = size < numSamples ? size : numSamples;
+    uint32_t stride = size / numSamples;
+
+    // Saving the cells and writing the pattern in one go.
+    beginBlock();
+    switchToReadMode();
+    for (uint16_t i = 0; i < numSamples; i++) {
+        prevBytes[i] = readModifyWriteByte(i * stride, 0x00, retentionPattern(i), NULL);
+    }
+    endBlock();
+
+    bool isPatternWritten = true;
+    for (uint8_t step = 0; step < MEMORY_CHIP_RETENTION_STEPS; step++) {
+        // Only once it's decayed does the pattern need writing again.
+        if (!isPatternWritten) {
+            beginBlock();
+            switchToWriteMode();
+            for (uint16_t i = 0; i < numSamples; i++) {
+                writeByte(i * stride, retentionPattern(i));
+            }
+            endBlock();
+            isPatternWritten = true;
+        }
 
-    // Alternate version of the paragraph above, which tests how much of the
-    // data was lost. Useful for testing how quickly the SRAM chip loses data.
-    // switchToReadMode();
-    // uint16_t numMessedUp = 0;
-    // for (uint16_t address = 0; address < testLength; address++) {
-    //     if (readByte(address) != 0x22) {
-    //         numMessedUp++;
-    //     }
-    // }
-    // Serial.write(static_cast<uint8_t>(numMessedUp >> 8));
-    // Serial.write(static_cast<uint8_t>(numMessedUp));
-    // bool isNonVolatile = !static_cast<bool>(numMessedUp);
+        uint32_t offMicros = static_cast<uint32_t>(MEMORY_CHIP_RETENTION_MIN_OFF_MICROS)
+                             << (2 * step);
+        _powerOffFor(offMicros);
+
+        beginBlock();
+        switchToReadMode();
+        uint16_t decayedCells = 0;
+        for (uint16_t i = 0; i < numSamples; i++) {
+            if (readByte(i * stride) != retentionPattern(i)) {
+                decayedCells++;
+            }
+        }
+        endBlock();
+
+        if (decayedCells) {
+            isPatternWritten = false;
+        }
+        points[step].offMicros = offMicros;
+        points[step].decayedCells = decayedCells;
+    }
 
     // It's like we were never there.
+    beginBlock();
     switchToWriteMode();
-    writeBytes(0, prevBytes, testLength);
-    delete[] prevBytes;
+    for (uint16_t i = 0; i < numSamples; i++) {
+        writeByte(i * stride, prevBytes[i]);
+    }
+    endBlock();
+    returnScratchBuffer();
 
-    return isNonVolatile;
+    return numSamples;
 }
 
-bool MemoryChip::allAddressesWork()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_powerOffFor(
+    uint32_t micros)
+{
+    powerOff();
+    // delayMicroseconds only goes up to 16383.
+    if (micros >= 16384) {
+        delay(micros / 1000);
+        micros %= 1000;
+    }
+    delayMicroseconds(micros);
+    powerOn();
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::allAddressesWork()
 {
     if (!_knownProperties.size) {
         return false; // Not that it means anything in this edge case.
@@ -347,43 +663,233 @@ bool MemoryChip::allAddressesWork()
     return addressesWorkBetween(0, _properties.size);
 }
 
-bool MemoryChip::addressesWorkBetween(uint32_t start, uint32_t end)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::addressesWorkBetween(
+    uint32_t start, uint32_t end)
+{
+    MarchAlgorithm algorithm;
+    getMarchAlgorithm(MARCH_TEST_DEFAULT_ALGORITHM, &algorithm);
+    return runMarchTest(algorithm, start, end, NULL, NULL);
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::runMarchTest(
+    const MarchAlgorithm& algorithm, uint32_t start, uint32_t end,
+    MarchTestResult* result, MarchTestProgressCallback progress)
 {
-    bool wasInWriteMode = _inWriteMode;
+    bool wasInWriteMode = _busMode == BusMode::WRITE;
+
+    MarchTestResult r = {true, 0, 0, 0};
+    uint32_t numCells = end > start ? end - start : 0;
+
+    beginBlock();
+    // First, a read-only pass to work out what each element's signature
+    // should be, if its first reads are R0s and R1s respectively.
+    switchToReadMode();
+    uint32_t expectedSignatures[2] = {0, 0};
+    for (uint32_t address = start; address < end; address++) {
+        uint8_t n = readByte(address);
+        expectedSignatures[0] += marchSignatureOf(address, n);
+        expectedSignatures[1] += marchSignatureOf(address, ~n);
+    }
 
-    bool addressesWorked = true;
+    // Read mode's home base from here on - writes switch back afterwards.
+    for (uint8_t e = 0; e < algorithm.numElements; e++) {
+        MarchElement element;
+        getMarchElement(algorithm, e, &element);
+        uint32_t signature = 0;
 
-    // Same length as in the non-volatility test.
-    uint8_t* window = new uint8_t[512];
-    for (uint32_t windowStart = start; windowStart < end && addressesWorked; windowStart += 512) {
-        uint32_t windowEnd = windowStart + 512;
-        windowEnd = windowEnd <= end ? windowEnd : end;
-        uint32_t length = windowEnd - windowStart;
+        for (uint32_t i = 0; i < numCells; i++) {
+            uint32_t address = element.isDescending ? end - 1 - i : start + i;
+            // What the cell held before the test, as far as we can tell,
+            // and its complement. The 0s and 1s of the operations, that is.
+            uint8_t values[2] = {0, 0};
+            for (uint8_t o = 0; o < element.numOperations; o++) {
+                MarchOperation operation = element.operations[o];
+                if (isMarchWrite(operation)) {
+                    // Only if it doesn't come right after a read.
+                    switchToWriteMode();
+                    writeByte(address, values[operation == MARCH_W1]);
+                    switchToReadMode();
+                    continue;
+                }
 
-        // Get the data that was there before...
-        switchToReadMode();
-        readBytes(windowStart, window, length);
+                // A read and the write after it make one bus cycle, and so
+                // does the read after that - unless it's got a write of its
+                // own to make a cycle with. The first read's write is relative
+                // to what it reads, since that's what the 0s and 1s are.
+                uint8_t n;
+                uint8_t verified;
+                const MarchOperation* next = element.operations + o + 1;
+                uint8_t numNext = element.numOperations - o - 1;
+                bool isWriteNext = numNext >= 1 && isMarchWrite(next[0]);
+                bool isVerified = isWriteNext && numNext >= 2 && !isMarchWrite(next[1]) &&
+                                  !(numNext >= 3 && isMarchWrite(next[2]));
+                if (!isWriteNext) {
+                    n = readByte(address);
+                } else if (o == 0) {
+                    bool isFlip = (operation == MARCH_R1) !=
+                                  (element.operations[o + 1] == MARCH_W1);
+                    n = readModifyWriteByte(address, 0xFF, isFlip ? 0xFF : 0x00,
+                                            isVerified ? &verified : NULL);
+                } else {
+                    n = readModifyWriteByte(address, 0x00,
+                                            values[element.operations[o + 1] == MARCH_W1],
+                                            isVerified ? &verified : NULL);
+                }
 
-        // Write other data...
-        switchToWriteMode();
-        for (uint32_t i = 0; i < length; i++) {
-            writeByte(windowStart + i, window[i] ^ 0xFF);
+                if (o == 0) {
+                    values[operation == MARCH_R1] = n;
+                    values[operation == MARCH_R0] = ~n;
+                    signature += marchSignatureOf(address, n);
+                } else if (n != values[operation == MARCH_R1]) {
+                    if (!r.mismatches) {
+                        r.firstMismatchAddress = address;
+                    }
+                    r.mismatches++;
+                }
+                if (isVerified && verified != values[element.operations[o + 2] == MARCH_R1]) {
+                    if (!r.mismatches) {
+                        r.firstMismatchAddress = address;
+                    }
+                    r.mismatches++;
+                }
+                o += isVerified ? 2 : isWriteNext ? 1 : 0;
+            }
+
+            if (progress && (i & 0xFF) == 0xFF) {
+                progress();
+            }
         }
 
-        // Confirm that the write worked...
+        bool firstReadIsR1 = element.operations[0] == MARCH_R1;
+        if (signature != expectedSignatures[firstReadIsR1]) {
+            r.failedElements |= 1 << e;
+        }
+    }
+    endBlock();
+
+    if (wasInWriteMode) {
+        switchToWriteMode();
+    } else {
         switchToReadMode();
-        for (uint32_t i = 0; i < length; i++) {
-            if (readByte(windowStart + i) != (window[i] ^ 0xFF)) {
-                addressesWorked = false;
-                break;
+    }
+
+    r.passed = !r.mismatches && !r.failedElements;
+    if (result) {
+        *result = r;
+    }
+    return r.passed;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::diagnoseLines(
+    uint8_t addressWidth, MemoryChipLineDiagnosis* diagnosis)
+{
+    if (!addressWidth || addressWidth > BasicMemoryChip::addressWidth()) {
+        addressWidth = BasicMemoryChip::addressWidth();
+        if (_knownProperties.size) {
+            addressWidth = 0;
+            while ((static_cast<uint32_t>(1) << addressWidth) < _properties.size) {
+                addressWidth++;
             }
         }
+    }
+    MemoryChipLineDiagnosis d = {0, 0, 0, addressWidth, false, 0, 0};
+    // The address lines' test touches two cells per line, plus two more.
+    uint8_t numAddresses = 2 * (addressWidth + 1);
+    uint8_t* buffer = borrowScratchBuffer();
+    if (!buffer || SCRATCH_BUFFER_SIZE < 2 * numAddresses) {
+        if (buffer) {
+            returnScratchBuffer();
+        }
+        return false;
+    }
+    bool wasInWriteMode = _busMode == BusMode::WRITE;
+    beginBlock();
+
+    // The data lines first, at address 0: write each walking one and walking
+    // zero, and see what comes back. A line that never reads high (or low) is
+    // stuck, and a line that changes along with another one is shorted to it.
+    // Each write and its read back are one bus cycle, and the first one
+    // saves what was there, too.
+    switchToReadMode();
+    uint8_t prevByte = 0;
+    uint8_t patterns[16];
+    uint8_t readBack[16];
+    uint8_t alwaysHigh = 0xFF;
+    uint8_t everHigh = 0x00;
+    for (uint8_t i = 0; i < 16; i++) {
+        patterns[i] = i < 8 ? 1 << i : ~(1 << (i - 8));
+        uint8_t n = readModifyWriteByte(0, 0x00, patterns[i], &readBack[i]);
+        if (i == 0) {
+            prevByte = n;
+        }
+        alwaysHigh &= readBack[i];
+        everHigh |= readBack[i];
+    }
+    d.dataStuckHigh = alwaysHigh;
+    d.dataStuckLow = ~everHigh;
+    uint8_t dataStuck = d.dataStuckHigh | d.dataStuckLow;
+    for (uint8_t i = 0; i < 16; i++) {
+        uint8_t wrongBits = (readBack[i] ^ patterns[i]) & ~dataStuck;
+        if (wrongBits) {
+            // The walked bit's line is in on it too.
+            d.dataShorted |= wrongBits | (1 << (i % 8));
+        }
+    }
+    d.dataShorted &= ~dataStuck;
 
-        // And put the old data back.
+    // Then the address lines, which needs working data lines. Every cell at
+    // 0 and at each power of two gets a different value, and so does every
+    // cell at all ones and at all ones minus each power of two. Cells that
+    // read back the same value are the same cell. A line i is stuck if 0 and
+    // 1 << i are the same cell, and its all-ones counterparts are too - and
+    // two lines are shorted if their cells are the same as each other's, but
+    // not as the base's.
+    if (!dataStuck && !d.dataShorted) {
+        d.addressesTested = true;
+        uint32_t allOnes = (static_cast<uint32_t>(1) << addressWidth) - 1;
+        uint8_t* saved = buffer;
+        uint8_t* tags = buffer + numAddresses;
+        // Saving and tagging in one go. If a cell's an alias of an earlier
+        // one, what's saved is that one's tag - but since the restoring goes
+        // in reverse, the earlier one's original gets the last word.
+        for (uint8_t k = 0; k < numAddresses; k++) {
+            saved[k] = readModifyWriteByte(_diagnosisAddress(k, addressWidth, allOnes),
+                                           0x00, 0x10 + k, NULL);
+        }
+        for (uint8_t k = 0; k < numAddresses; k++) {
+            tags[k] = readByte(_diagnosisAddress(k, addressWidth, allOnes));
+        }
         switchToWriteMode();
-        writeBytes(windowStart, window, length);
+        for (uint8_t k = numAddresses; k > 0; k--) {
+            writeByte(_diagnosisAddress(k - 1, addressWidth, allOnes), saved[k - 1]);
+        }
+
+        const uint8_t* lows = tags;
+        const uint8_t* highs = tags + addressWidth + 1;
+        for (uint8_t i = 0; i < addressWidth; i++) {
+            if (lows[i + 1] == lows[0] && highs[i + 1] == highs[0]) {
+                d.addressStuck |= static_cast<uint32_t>(1) << i;
+            }
+        }
+        for (uint8_t i = 0; i < addressWidth; i++) {
+            for (uint8_t j = i + 1; j < addressWidth; j++) {
+                if ((lows[i + 1] == lows[j + 1] && lows[i + 1] != lows[0]) ||
+                    (highs[i + 1] == highs[j + 1] && highs[i + 1] != highs[0])) {
+                    d.addressShorted |= static_cast<uint32_t>(1) << i |
+                                        static_cast<uint32_t>(1) << j;
+                }
+            }
+        }
+        d.addressShorted &= ~d.addressStuck;
     }
-    delete[] window;
+
+    switchToWriteMode();
+    writeByte(0, prevByte);
+    endBlock();
+    returnScratchBuffer();
 
     if (wasInWriteMode) {
         switchToWriteMode();
@@ -391,48 +897,197 @@ bool MemoryChip::addressesWorkBetween(uint32_t start, uint32_t end)
         switchToReadMode();
     }
 
-    return addressesWorked;
+    *diagnosis = d;
+    return true;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint32_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_diagnosisAddress(
+    uint8_t k, uint8_t addressWidth, uint32_t allOnes)
+{
+    // 0, 1, 2, 4, ..., then all ones, all ones minus 1, minus 2, minus 4...
+    bool isHigh = k > addressWidth;
+    uint8_t i = isHigh ? k - (addressWidth + 1) : k;
+    uint32_t base = isHigh ? allOnes : 0;
+    return i ? base ^ (static_cast<uint32_t>(1) << (i - 1)) : base;
 }
 
-void MemoryChip::switchToReadMode()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::switchToReadMode()
 {
-    _inWriteMode = false;
+    if (_busMode == BusMode::READ) {
+        return;
+    }
+    _busMode = BusMode::READ;
     _dataChannel->initInput();
+    STATS_COUNT(STATS_MODE_SWITCHES);
 }
 
-uint8_t MemoryChip::readByte(uint16_t address)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint8_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::readByte(
+    Address address)
 {
-    // TODO: Implement slow mode here and there and everywhere.
-    _addressChannel->output(address);
-    SET_BITS_IN_PORT_LOW(_cePin.out, _cePin.bitMask);
-    SET_BITS_IN_PORT_LOW(_oePin.out, _oePin.bitMask);
+    beginReadByte(address);
+    return completeReadByte();
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+inline void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_waitForStrobe()
+{
+    // Just a load and a branch for chips that keep up without it, which is
+    // most of them. (delayMicroseconds(0) would still cost a call.)
+    if (_properties.strobeMicros) {
+        delayMicroseconds(_properties.strobeMicros);
+    }
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::beginReadByte(
+    Address address)
+{
+    _addressChannel->beginOutput(address);
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint8_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::completeReadByte()
+{
+    _addressChannel->completeOutput();
+    _pins.ce.setLow();
+    _pins.oe.setLow();
+    _waitForStrobe();
     uint8_t data = _dataChannel->input();
-    SET_BITS_IN_PORT_HIGH(_cePin.out, _cePin.bitMask);
-    SET_BITS_IN_PORT_HIGH(_oePin.out, _oePin.bitMask);
+    _pins.ce.setHigh();
+    _pins.oe.setHigh();
+    STATS_COUNT(STATS_BYTES_READ);
+    return data;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::beginBlock()
+{
+    _addressChannel->beginBlock();
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::endBlock()
+{
+    _addressChannel->endBlock();
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint8_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_completeReadByteAndBegin(
+    Address nextAddress)
+{
+    uint8_t data = completeReadByte();
+    beginReadByte(nextAddress);
     return data;
 }
 
-size_t MemoryChip::readBytes(uint16_t address, uint8_t* dest, size_t length)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+size_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::readBytes(
+    Address address, uint8_t* dest, size_t length)
 {
-    size_t i;
-    for (i = 0; i < length; i++) {
-        dest[i] = readByte(address);
-        address++;
+    if (length == 0) {
+        return 0;
+    }
+
+    // Pipelined: the next address shifts out while the byte just read
+    // is being stored. Sadly, the high byte of the address can't be skipped
+    // when it hasn't changed - with the shift registers daisy-chained,
+    // shifting out only the low byte would move the old low byte up.
+    beginBlock();
+    uint8_t* last = dest + length - 1;
+    beginReadByte(address);
+    while (last - dest >= 4) {
+        dest[0] = _completeReadByteAndBegin(++address);
+        dest[1] = _completeReadByteAndBegin(++address);
+        dest[2] = _completeReadByteAndBegin(++address);
+        dest[3] = _completeReadByteAndBegin(++address);
+        dest += 4;
+    }
+    while (dest < last) {
+        *dest++ = _completeReadByteAndBegin(++address);
     }
+    *dest = completeReadByte();
+    endBlock();
     // It's fairly worthless to return the number of written bytes here,
     // but it could be nice for consistency if there's ever a version of
     // this function that validates the length.
     // There might never be such a version, but hey. Hey.
-    return i;
+    return length;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+uint8_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::readModifyWriteByte(
+    Address address, uint8_t andMask, uint8_t xorMask, uint8_t* verify)
+{
+    if (_properties.isSlow) {
+        // An EEPROM's write has to be waited out, and that takes reads of
+        // its own - so it's the long way round for those.
+        uint8_t data = readByte(address);
+        switchToWriteMode();
+        writeByte(address, (data & andMask) ^ xorMask);
+        switchToReadMode();
+        if (verify) {
+            *verify = readByte(address);
+        }
+        return data;
+    }
+
+    // OE reads, and then WE writes - a WE-controlled write, with CE still
+    // active from the read. The data bus turns around while neither OE nor
+    // WE is, so the chip and the MCU never drive it at the same time.
+    _addressChannel->output(address);
+    _pins.ce.setLow();
+    _pins.oe.setLow();
+    _waitForStrobe();
+    uint8_t data = _dataChannel->input();
+    _pins.oe.setHigh();
+    switchToWriteMode();
+    _dataChannel->output((data & andMask) ^ xorMask);
+    _pins.we.setLow();
+    _waitForStrobe();
+    _pins.we.setHigh();
+    switchToReadMode();
+    if (verify) {
+        _pins.oe.setLow();
+        _waitForStrobe();
+        *verify = _dataChannel->input();
+        _pins.oe.setHigh();
+        STATS_COUNT(STATS_BYTES_READ);
+    }
+    _pins.ce.setHigh();
+    STATS_COUNT(STATS_BYTES_READ);
+    STATS_COUNT(STATS_BYTES_WRITTEN);
+    return data;
 }
 
-void MemoryChip::switchToWriteMode()
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::switchToWriteMode()
 {
-    _inWriteMode = true;
+    if (_busMode == BusMode::WRITE) {
+        return;
+    }
+    _busMode = BusMode::WRITE;
     _dataChannel->initOutput();
+    STATS_COUNT(STATS_MODE_SWITCHES);
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::writeByte(
+    Address address, uint8_t data)
+{
+    if (_properties.isSlow) {
+        _writePage(address, &data, 1);
+        return;
+    }
+    _strobeWrite(address, data);
+    STATS_COUNT(STATS_BYTES_WRITTEN);
 }
 
-void MemoryChip::writeByte(uint16_t address, uint8_t data)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+inline void BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_strobeWrite(
+    Address address, uint8_t data)
 {
     // MemoryChip::writeByte benchmarks with different _addressChannel types
     // (16 MHz ATmega328P, _dataChannel is always InputOutput_Port):
@@ -442,22 +1097,186 @@ void MemoryChip::writeByte(uint16_t address, uint8_t data)
     // * Output_SpiShiftRegister: ~27 µs
     // Holy heck! SPI brought it down like crazy! That is way under the
     // target <69 µs that a serial baud rate of 115200 requires!
+    //
+    // That ~27 µs (~430 cycles) was with the runtime-polymorphic MemoryChip.
+    // Counting cycles, roughly a third of it is overhead that a BasicMemoryChip
+    // specialized on the concrete channel types gets rid of:
+    // * 3 indirect calls (address, data set, and - via the virtual base
+    //   thunk - each port), ~20 cycles each with call/ret and vtable loads.
+    // * Prologues/epilogues of the 5 out-of-line functions: ~60 cycles.
+    // * Loop-variable shifts in Output_Spi and InputOutput_Port (these are
+    //   bit-by-bit loops on AVR), which become constant: ~40 cycles.
+    // That puts the estimate at ~17-19 µs. Not yet measured on hardware!
 
-    _addressChannel->output(address);
+    // The data bus is set up while the address is still shifting out.
+    // CE is high, so the chip doesn't care that the address isn't there yet.
+    _addressChannel->beginOutput(address);
     _dataChannel->output(data);
+    _addressChannel->completeOutput();
     // WE is active when CE is activated, so we're doing a CE-controlled write.
-    SET_BITS_IN_PORT_LOW(_wePin.out, _wePin.bitMask);
-    SET_BITS_IN_PORT_LOW(_cePin.out, _cePin.bitMask);
-    SET_BITS_IN_PORT_HIGH(_cePin.out, _cePin.bitMask);
-    SET_BITS_IN_PORT_HIGH(_wePin.out, _wePin.bitMask);
+    _pins.we.setLow();
+    _pins.ce.setLow();
+    _waitForStrobe();
+    _pins.ce.setHigh();
+    _pins.we.setHigh();
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+size_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::writeBytes(
+    Address address, uint8_t* source, size_t length)
+{
+    if (_properties.isSlow) {
+        // A page at a time, with one write cycle each, rather than one per
+        // byte - 64 times faster on a 28C256.
+        size_t written = 0;
+        while (written < length) {
+            uint8_t pageLength = MEMORY_CHIP_EEPROM_PAGE_SIZE -
+                                 address % MEMORY_CHIP_EEPROM_PAGE_SIZE;
+            if (pageLength > length - written) {
+                pageLength = length - written;
+            }
+            if (!_writePage(address, source, pageLength)) {
+                break;
+            }
+            address += pageLength;
+            source += pageLength;
+            written += pageLength;
+        }
+        return written;
+    }
+
+    beginBlock();
+    uint8_t* end = source + length;
+    while (end - source >= 4) {
+        _strobeWrite(address++, source[0]);
+        _strobeWrite(address++, source[1]);
+        _strobeWrite(address++, source[2]);
+        _strobeWrite(address++, source[3]);
+        source += 4;
+    }
+    while (source < end) {
+        _strobeWrite(address++, *source++);
+    }
+    endBlock();
+    STATS_ADD(STATS_BYTES_WRITTEN, length);
+    return length;
 }
 
-size_t MemoryChip::writeBytes(uint16_t address, uint8_t* source, size_t length)
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+size_t BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::writeChangedBytes(
+    Address address, uint8_t* source, size_t length, uint32_t* changed)
 {
-    size_t i;
-    for (i = 0; i < length; i++) {
-        writeByte(address, source[i]);
-        address++;
+    beginBlock();
+    size_t written = 0;
+    if (_properties.isSlow) {
+        // A page at a time, like writeBytes. Only the stretch between the
+        // first and last changed bytes gets loaded, and since a page's write
+        // cycle takes as long whatever's in it, the rest costs nothing extra.
+        while (written < length) {
+            uint8_t pageLength = MEMORY_CHIP_EEPROM_PAGE_SIZE -
+                                 address % MEMORY_CHIP_EEPROM_PAGE_SIZE;
+            if (pageLength > length - written) {
+                pageLength = length - written;
+            }
+            switchToReadMode();
+            uint8_t first = pageLength;
+            uint8_t last = 0;
+            for (uint8_t i = 0; i < pageLength; i++) {
+                if (readByte(address + i) != source[i]) {
+                    if (first == pageLength) {
+                        first = i;
+                    }
+                    last = i;
+                    (*changed)++;
+                }
+            }
+            switchToWriteMode();
+            if (first < pageLength &&
+                !_writePage(address + first, source + first, last - first + 1)) {
+                break;
+            }
+            address += pageLength;
+            source += pageLength;
+            written += pageLength;
+        }
+        endBlock();
+        return written;
+    }
+
+    // The bus only turns around for the bytes that need writing.
+    switchToReadMode();
+    for (; written < length; written++) {
+        if (readByte(address + written) != source[written]) {
+            switchToWriteMode();
+            writeByte(address + written, source[written]);
+            switchToReadMode();
+            (*changed)++;
+        }
+    }
+    switchToWriteMode();
+    endBlock();
+    return written;
+}
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_writePage(
+    Address address, const uint8_t* source, uint8_t length)
+{
+    // The bytes of a page have to come in quick succession (within 150 µs
+    // of each other on a 28C256), or the chip starts writing without the
+    // rest - so no dawdling in here. They all have to be within one page,
+    // too, or they wrap around to its start.
+    beginBlock();
+    if (_properties.usesDataProtection) {
+        // Unlocks the next page write, and leaves protection on after it.
+        // The unlock addresses are A0-A14 for a 28C256, and however many
+        // of those the chip has for smaller ones.
+        Address mask = _knownProperties.size && _properties.size ?
+                       static_cast<Address>(_properties.size - 1) :
+                       static_cast<Address>(0x7FFF);
+        _strobeWrite(0x5555 & mask, 0xAA);
+        _strobeWrite(0x2AAA & mask, 0x55);
+        _strobeWrite(0x5555 & mask, 0xA0);
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        _strobeWrite(address + i, source[i]);
+        STATS_COUNT(STATS_BYTES_WRITTEN);
     }
-    return i;
+    bool isWritten = _waitForWriteCycle(address + length - 1, source[length - 1]);
+    endBlock();
+    return isWritten;
 }
+
+template <class AddressChannelType, class DataChannelType, class ControlPinsType>
+bool BasicMemoryChip<AddressChannelType, DataChannelType, ControlPinsType>::_waitForWriteCycle(
+    Address address, uint8_t data)
+{
+    // There are two ways an EEPROM tells that it's still busy writing, and
+    // chips do one or the other or both: DATA# polling (reading the last
+    // byte written gives its bit 7 inverted) and toggle-bit polling (bit 6
+    // flips on every read). It's done when neither's going on - and then,
+    // it's written if the byte reads back right.
+    unsigned long int startedAt = micros();
+    switchToReadMode();
+    uint8_t prevByte = readByte(address);
+    bool isWritten = false;
+    for (;;) {
+        uint8_t byte = readByte(address);
+        if (byte == prevByte && !((byte ^ data) & 0x80)) {
+            isWritten = byte == data;
+            break;
+        }
+        if (micros() - startedAt >= MEMORY_CHIP_SLOW_WRITE_CYCLE_MILLIS * 1000UL) {
+            break;
+        }
+        prevByte = byte;
+    }
+    switchToWriteMode();
+    return isWritten;
+}
+
+#else
+// Non-template implementations.
+#include "memorychip.hpp"
+
+#endif
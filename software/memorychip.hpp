@@ -4,20 +4,82 @@
 #include <stdint.h>
 #include "channelio.hpp"
 #include "fastpins.hpp"
+#include "marchtest.hpp"
+#include "scratch.hpp"
+#include "stats.hpp"
 
-// MemoryChip::analyze() will check sizes between these two bit widths.
-// To support memory chips of, say, up to 128 KiB, this max would need to be
-// raised to 17, and MemoryChip would need to be a template that takes the
-// integer type (uint32_t, in the case of 128 KiB) of its address as a
-// parameter. In that case, it wouldn't make too much sense to have the same
-// min/max for each type of MemoryChip, either.
-#define MEMORY_CHIP_MAX_ADDRESS_WIDTH 16
+// MemoryChip::analyze() will check sizes between these two bit widths - or
+// rather, up to however many bits the address channel has, if that's fewer.
+// A 16-bit address channel (two 74HC595s) takes chips of up to 64 KiB, and
+// a 24-bit one (three of them; see uint24_t in channelio.hpp) up to 16 MiB.
+#define MEMORY_CHIP_MAX_ADDRESS_WIDTH 24
 #define MEMORY_CHIP_MIN_ADDRESS_WIDTH 8
 
-// How many addresses a byte may be mirrored at, given the above parameters.
-#define MEMORY_CHIP_POSSIBLE_MIRRORS ( \
-    MEMORY_CHIP_MAX_ADDRESS_WIDTH - MEMORY_CHIP_MIN_ADDRESS_WIDTH + 1 \
-)
+// The non-volatility test powers the chip off for longer and longer, until
+// a sample of its cells loses its data: MEMORY_CHIP_RETENTION_STEPS off
+// times, starting at MEMORY_CHIP_RETENTION_MIN_OFF_MICROS and 4x longer
+// each step after that. SRAM usually gives up within the first step or two,
+// so that's where the test ends for it - a chip has to keep its data through
+// every last step to count as non-volatile.
+#ifndef MEMORY_CHIP_RETENTION_STEPS
+#define MEMORY_CHIP_RETENTION_STEPS 5
+#endif
+#ifndef MEMORY_CHIP_RETENTION_MIN_OFF_MICROS
+#define MEMORY_CHIP_RETENTION_MIN_OFF_MICROS 250
+#endif
+// How many cells get checked, spread evenly across the chip (rows of cells
+// can have different retention, so a block at the start isn't as good).
+// Capped at SCRATCH_BUFFER_SIZE, since their contents get saved there.
+#ifndef MEMORY_CHIP_RETENTION_SAMPLES
+#define MEMORY_CHIP_RETENTION_SAMPLES 64
+#endif
+
+// Timing, for chips that can't keep up with the MCU flat out. Until it's
+// been calibrated (see MemoryChip::analyze), a chip gets a power-on settle
+// time that's plenty for every chip seen so far, and no extra strobe time.
+// Calibration tries shorter and shorter times until the chip stops keeping
+// up, and then adds MEMORY_CHIP_TIMING_MARGIN_PERCENT back on top.
+#ifndef MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS
+#define MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS 180
+#endif
+// EEPROMs like the 28C256 ignore writes for ~5 ms after powering on, hence
+// the long maximum. (delayMicroseconds only goes up to 16383.)
+#ifndef MEMORY_CHIP_MAX_POWER_ON_SETTLE_MICROS
+#define MEMORY_CHIP_MAX_POWER_ON_SETTLE_MICROS 16000
+#endif
+#ifndef MEMORY_CHIP_MAX_STROBE_MICROS
+#define MEMORY_CHIP_MAX_STROBE_MICROS 32
+#endif
+#ifndef MEMORY_CHIP_TIMING_MARGIN_PERCENT
+#define MEMORY_CHIP_TIMING_MARGIN_PERCENT 50
+#endif
+// How many times in a row a timing has to work to count as reliable.
+#ifndef MEMORY_CHIP_TIMING_TRIALS
+#define MEMORY_CHIP_TIMING_TRIALS 4
+#endif
+// How long the chip's powered off for when calibrating the settle time -
+// long enough that it's really off, not just running off its decoupling caps.
+#ifndef MEMORY_CHIP_TIMING_OFF_MICROS
+#define MEMORY_CHIP_TIMING_OFF_MICROS 1000
+#endif
+// Slow chips (EEPROMs) are busy for a while after every write - or rather,
+// after every page written, with writeBytes. 10 ms is the longest write
+// cycle of the usual suspects, like the 28C256, so a write that takes any
+// longer than that counts as failed. Their pages are 64 bytes; for chips
+// with smaller ones, make this match.
+#ifndef MEMORY_CHIP_SLOW_WRITE_CYCLE_MILLIS
+#define MEMORY_CHIP_SLOW_WRITE_CYCLE_MILLIS 10
+#endif
+#ifndef MEMORY_CHIP_EEPROM_PAGE_SIZE
+#define MEMORY_CHIP_EEPROM_PAGE_SIZE 64
+#endif
+
+// One point of MemoryChip::measureRetention's curve.
+struct MemoryChipRetentionPoint
+{
+    uint32_t offMicros;
+    uint16_t decayedCells;
+};
 
 struct MemoryChipProperties
 {
@@ -25,6 +87,14 @@ struct MemoryChipProperties
     uint32_t size;
     bool isNonVolatile;
     bool isSlow;
+    // How long powerOn waits before the chip can be used.
+    uint16_t powerOnSettleMicros;
+    // How long CE stays active for each read and write.
+    uint8_t strobeMicros;
+    // Whether a slow chip's writes need software data protection's unlock
+    // sequence in front of them. Writing like this turns protection on, so
+    // setting this on a chip that doesn't have it yet will.
+    bool usesDataProtection;
 };
 
 struct MemoryChipKnownProperties
@@ -33,16 +103,80 @@ struct MemoryChipKnownProperties
     bool size : 1;
     bool isNonVolatile : 1;
     bool isSlow : 1;
+    bool powerOnSettleMicros : 1;
+    bool strobeMicros : 1;
+    bool usesDataProtection : 1;
+};
+
+// What MemoryChip::diagnoseLines found. Bit n of each mask is line n.
+// From here, a stuck line and one that isn't connected at all look the same:
+// an open data line reads high thanks to the pull-ups, and an open address
+// line is as good as stuck at whatever the chip makes of it.
+struct MemoryChipLineDiagnosis
+{
+    uint8_t dataStuckLow;
+    uint8_t dataStuckHigh;
+    uint8_t dataShorted;
+    // How many address lines were checked, and whether they could be at all -
+    // with broken data lines, there's no telling what got written where.
+    uint8_t addressWidth;
+    bool addressesTested;
+    // Whether an address line's stuck high or low can't be told apart, since
+    // either way, the chip only ever sees half of its cells.
+    uint32_t addressStuck;
+    uint32_t addressShorted;
+};
+
+// Memory chip control pins, as a bundle of pin types (see fastpins.hpp).
+struct MemoryChipRuntimePins
+{
+    MemoryChipRuntimePins(unsigned int cePin, unsigned int oePin,
+                          unsigned int wePin, unsigned int powerPin) :
+        ce(cePin), oe(oePin), we(wePin), power(powerPin) {}
+    RuntimePin ce;
+    RuntimePin oe;
+    RuntimePin we;
+    RuntimePin power;
+};
+
+template <uint8_t cePin, uint8_t oePin, uint8_t wePin, uint8_t powerPin>
+struct MemoryChipStaticPins
+{
+    StaticPin<cePin> ce;
+    StaticPin<oePin> oe;
+    StaticPin<wePin> we;
+    StaticPin<powerPin> power;
 };
 
-class MemoryChip
+// The address and data channel types are template parameters so that a
+// layout whose channels are known at compile time (see software.ino) gets
+// the whole per-byte path inlined, with no virtual calls in the way. Pass the
+// abstract channel types to get a runtime-polymorphic chip instead - that's
+// what the MemoryChip typedef below is for. Likewise, MemoryChipStaticPins
+// makes the CE/OE/WE strobes single instructions.
+template <class AddressChannelType, class DataChannelType,
+          class ControlPinsType = MemoryChipRuntimePins>
+class BasicMemoryChip
 {
 public:
-    MemoryChip(OutputChannel<uint16_t>* addressChannel,
-               InputOutputChannel<uint8_t>* dataChannel,
-               unsigned int cePin, unsigned int oePin,
-               unsigned int wePin, unsigned int powerPin,
-               uint8_t powerPinOnState);
+    // The address channel's type decides how wide addresses are.
+    typedef typename AddressChannelType::ValueType Address;
+    static constexpr uint8_t addressWidth()
+    {
+        return sizeof(Address) * 8 < MEMORY_CHIP_MAX_ADDRESS_WIDTH ?
+               sizeof(Address) * 8 : MEMORY_CHIP_MAX_ADDRESS_WIDTH;
+    }
+
+    BasicMemoryChip(AddressChannelType* addressChannel,
+                    DataChannelType* dataChannel,
+                    ControlPinsType controlPins,
+                    uint8_t powerPinOnState);
+    // Shorthand for MemoryChipRuntimePins.
+    BasicMemoryChip(AddressChannelType* addressChannel,
+                    DataChannelType* dataChannel,
+                    unsigned int cePin, unsigned int oePin,
+                    unsigned int wePin, unsigned int powerPin,
+                    uint8_t powerPinOnState);
     void initPins();
 
     bool getIsOn();
@@ -55,34 +189,113 @@ public:
                        const MemoryChipProperties* properties);
     void analyzeUnknownProperties();
     void analyze();
+    // These run MARCH_TEST_DEFAULT_ALGORITHM.
     bool allAddressesWork();
     bool addressesWorkBetween(uint32_t start, uint32_t end);
+    // Runs a march test (see marchtest.hpp) on the addresses from start up
+    // to, but not including, end. Leaves the data as it was, as long as the
+    // chip works. result and progress may be NULL.
+    bool runMarchTest(const MarchAlgorithm& algorithm,
+                      uint32_t start, uint32_t end,
+                      MarchTestResult* result,
+                      MarchTestProgressCallback progress);
+    // Goes through every step of the non-volatility test (see above), and
+    // fills in points with how many of the sampled cells lost their data at
+    // each one. Leaves the data as it was. Returns how many cells were
+    // sampled, or 0 if it couldn't run (if the scratch buffer's taken).
+    uint16_t measureRetention(MemoryChipRetentionPoint points[MEMORY_CHIP_RETENTION_STEPS]);
+    // Checks each data and address line on its own, with walking ones and
+    // zeros - a few dozen accesses, as opposed to a march test's hundreds of
+    // thousands. With an addressWidth of 0, the chip's known size decides
+    // how many address lines to check (or addressWidth() if it isn't
+    // known). Leaves the data as it was. Returns false if it couldn't run at
+    // all (if the scratch buffer's taken).
+    bool diagnoseLines(uint8_t addressWidth, MemoryChipLineDiagnosis* diagnosis);
     
+    // Brackets a run of reads and/or writes, so that the address channel
+    // can skip its per-address setup (e.g. an SPI transaction) in between.
+    // readBytes and writeBytes do this on their own. Blocks may be nested.
+    void beginBlock();
+    void endBlock();
+
     void switchToReadMode();
-    uint8_t readByte(uint16_t address);
-    size_t readBytes(uint16_t address, uint8_t* dest, size_t length);
+    uint8_t readByte(Address address);
+    // readByte split in two: beginReadByte starts shifting the address out,
+    // and completeReadByte finishes the read. Anything done in between
+    // (say, handling the previous byte) overlaps with the address shifting.
+    void beginReadByte(Address address);
+    uint8_t completeReadByte();
+    size_t readBytes(Address address, uint8_t* dest, size_t length);
+
+    // Reads a byte and writes over it in a single bus cycle: the address
+    // goes out once, CE stays active throughout, and the data bus only turns
+    // around in the middle. What gets written is the byte read, ANDed with
+    // andMask and then XORed with xorMask - so 0, n writes n, and 0xFF, 0xFF
+    // writes the complement of what was there. If verify isn't NULL, the
+    // byte gets read back into it too. Returns the byte as it was. The bus
+    // has to be in read mode, and is left that way.
+    uint8_t readModifyWriteByte(Address address, uint8_t andMask, uint8_t xorMask,
+                                uint8_t* verify);
 
     void switchToWriteMode();
-    void writeByte(uint16_t address, uint8_t data);
-    size_t writeBytes(uint16_t address, uint8_t* source, size_t length);
+    // On slow chips, these wait for the chip to finish writing, and
+    // writeBytes writes a page at a time. It returns how many bytes got
+    // written before one didn't, which on fast chips is all of them.
+    void writeByte(Address address, uint8_t data);
+    size_t writeBytes(Address address, uint8_t* source, size_t length);
+    // Like writeBytes, but only writes the bytes that differ from what the
+    // chip already holds - on an EEPROM, pages that are already right don't
+    // take a write cycle at all. Adds how many bytes it changed to changed.
+    size_t writeChangedBytes(Address address, uint8_t* source, size_t length,
+                             uint32_t* changed);
 private:
-    OutputChannel<uint16_t>* _addressChannel;
-    InputOutputChannel<uint8_t>* _dataChannel;
-    PinPortInfo _cePin;
-    PinPortInfo _oePin;
-    PinPortInfo _wePin;
-    PinPortInfo _powerPin;
+    AddressChannelType* _addressChannel;
+    DataChannelType* _dataChannel;
+    ControlPinsType _pins;
     uint8_t _powerPinOnState;
 
     bool _isOn = false;
-    bool _inWriteMode = false;
 
-    MemoryChipKnownProperties _knownProperties = {false, false, false, false};
-    MemoryChipProperties _properties = {false, 0, false, false};
+    // What the data bus is currently set up for, so that switching to the
+    // mode it's already in is free - plenty of code switches "just in case".
+    // READ means inputs, with pull-ups if the data channel uses them. Only
+    // initPins and the switchTo...Mode functions may touch the data bus's
+    // direction, or this'll get out of sync!
+    enum class BusMode : uint8_t {UNKNOWN, READ, WRITE};
+    BusMode _busMode = BusMode::UNKNOWN;
+
+    MemoryChipKnownProperties _knownProperties = {
+        false, false, false, false, false, false, false
+    };
+    MemoryChipProperties _properties = {
+        false, 0, false, false, MEMORY_CHIP_DEFAULT_POWER_ON_SETTLE_MICROS, 0, false
+    };
 
-    bool _testAddress(uint16_t address, bool slow);
+    uint8_t _completeReadByteAndBegin(Address nextAddress);
+
+    void _waitForStrobe();
+    void _strobeWrite(Address address, uint8_t data);
+    bool _writePage(Address address, const uint8_t* source, uint8_t length);
+    bool _waitForWriteCycle(Address address, uint8_t data);
+
+    bool _testAddress(Address address, bool slow);
+    bool _testSlowAddress(Address address);
+    void _calibrateStrobeMicros();
+    bool _settlesWithin(uint16_t settleMicros, Address address, uint8_t testByte);
+    void _calibratePowerOnSettleMicros();
     uint32_t _testSize();
     bool _testNonVolatility();
+    void _powerOffFor(uint32_t micros);
+    uint32_t _diagnosisAddress(uint8_t k, uint8_t addressWidth, uint32_t allOnes);
 };
 
+// For odd setups where the channels are only known at runtime.
+typedef BasicMemoryChip<OutputChannel<uint16_t>, InputOutputChannel<uint8_t>>
+    MemoryChip;
+
+// Same deal as in channelio.hpp.
+#define INCLUDING_MEMORYCHIP_TEMPLATES
+#include "memorychip.cpp"
+#undef INCLUDING_MEMORYCHIP_TEMPLATES
+
 #endif
@@ -0,0 +1,65 @@
+#include "scratch.hpp"
+
+#include <stdint.h>
+#include <Arduino.h>
+
+static uint8_t SCRATCH_BUFFER[SCRATCH_BUFFER_SIZE];
+static bool scratchBufferIsBorrowed = false;
+
+uint8_t* borrowScratchBuffer()
+{
+    if (scratchBufferIsBorrowed) {
+        return NULL;
+    }
+    scratchBufferIsBorrowed = true;
+    return SCRATCH_BUFFER;
+}
+
+void returnScratchBuffer()
+{
+    scratchBufferIsBorrowed = false;
+}
+
+#ifdef __AVR__
+// From avr-libc's malloc: the start of the heap, and its current end
+// (or 0 if nothing's been allocated yet). The stack grows down toward it.
+extern uint8_t __heap_start;
+extern void* __brkval;
+
+#define STACK_PAINT 0xC5
+
+static uint8_t* stackLimit()
+{
+    return __brkval ? static_cast<uint8_t*>(__brkval) : &__heap_start;
+}
+
+void paintUnusedStack()
+{
+    // An interrupt could push onto the stack anywhere below SP, so don't
+    // let one in while painting over that space.
+    uint8_t oldSREG = SREG;
+    noInterrupts();
+    uint8_t* p = stackLimit();
+    uint8_t* sp = reinterpret_cast<uint8_t*>(SP);
+    while (p < sp) {
+        *p++ = STACK_PAINT;
+    }
+    SREG = oldSREG;
+}
+
+uint16_t unusedStackBytes()
+{
+    // Whatever's still painted was never touched since painting.
+    uint8_t* p = stackLimit();
+    uint8_t* sp = reinterpret_cast<uint8_t*>(SP);
+    uint16_t count = 0;
+    while (p < sp && *p == STACK_PAINT) {
+        p++;
+        count++;
+    }
+    return count;
+}
+#else
+void paintUnusedStack() {}
+uint16_t unusedStackBytes() {return 0;}
+#endif
@@ -0,0 +1,32 @@
+#ifndef SCRATCH_HPP
+#define SCRATCH_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// One statically allocated buffer for everything that needs a bunch of
+// bytes for a little while - saving a chip's contents during a test,
+// holding data coming in over serial, and so on. Being static, it shows up
+// in the "Global variables use..." line when building, instead of failing
+// to fit in the heap at runtime. Only one thing can have it at a time.
+//
+// To pick the biggest size that's still safe, build, upload, give the
+// F-Ramune a workout (an analyze, a read and a write), and look at "Stack
+// never used" in framune.py's stats. Whatever that says is how much bigger
+// the buffer could be, give or take a safety margin.
+#ifndef SCRATCH_BUFFER_SIZE
+#define SCRATCH_BUFFER_SIZE 512
+#endif
+
+// Returns NULL if something else is already using the buffer.
+uint8_t* borrowScratchBuffer();
+void returnScratchBuffer();
+
+// For working out how much stack is left over. paintUnusedStack fills the
+// stack space that's not in use with a known value, and unusedStackBytes
+// checks how much of that is still there. Call paintUnusedStack early in
+// setup(). (Not available off-AVR, where unusedStackBytes always says 0.)
+void paintUnusedStack();
+uint16_t unusedStackBytes();
+
+#endif
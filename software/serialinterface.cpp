@@ -1,26 +1,41 @@
-#include "serialinterface.hpp"
+#include <stdint.h>
+#include <Arduino.h>
+
+#ifdef INCLUDING_SERIALINTERFACE_TEMPLATES
+// Template implementations.
 
-SerialInterface::SerialInterface(Stream* serial, MemoryChip* memoryChip) :
-    _serial(serial), _memoryChip(memoryChip) {}
+template <class MemoryChipType>
+BasicSerialInterface<MemoryChipType>::BasicSerialInterface(
+    Stream* serial, MemoryChipType* memoryChip,
+    SerialBaudRateFunction setBaudRate) :
+    _serial(serial), _memoryChip(memoryChip), _setBaudRate(setBaudRate) {}
 
-bool SerialInterface::update()
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::update()
 {
     // Return true if busy (i.e. next update will continue a task), false if not.
+    bool isBusy = false;
     switch (_state) {
     case SerialState::WAITING_FOR_COMMAND:
         return _checkForCommand();
         break;
     case SerialState::READING:
-        return _stateReading();
+        isBusy = _stateReading();
         break;
     case SerialState::WRITING:
-        return _stateWriting();
+        isBusy = _stateWriting();
         break;
     }
-    return false;
+    if (!isBusy) {
+        // A read or write just finished, which is when the host last did
+        // anything, as far as the idle timeout's concerned.
+        _lastCommandMillis = millis();
+    }
+    return isBusy;
 }
 
-void SerialInterface::_turnMemoryOnTemporarily()
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_turnMemoryOnTemporarily()
 {
     _prevMemoryPowerState = _memoryChip->getIsOn();
     if (!_prevMemoryPowerState) {
@@ -28,7 +43,8 @@ void SerialInterface::_turnMemoryOnTemporarily()
     }
 }
 
-void SerialInterface::_returnMemoryPowerState()
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_returnMemoryPowerState()
 {
     if (_prevMemoryPowerState && !_memoryChip->getIsOn()) {
         _memoryChip->powerOn();
@@ -37,22 +53,28 @@ void SerialInterface::_returnMemoryPowerState()
     }
 }
 
-int SerialInterface::_readByteWithTimeout(uint8_t& n)
+template <class MemoryChipType>
+int BasicSerialInterface<MemoryChipType>::_readByteWithTimeout(uint8_t& n)
 {
     if (!_serial->available()) {
         unsigned long int timeout = _serial->getTimeout();
         unsigned long int startedWaitingForByte = millis();
+        unsigned long int statsWaitStart = STATS_TIMESTAMP();
         while (!_serial->available()) {
             if (millis() - startedWaitingForByte >= timeout) {
+                STATS_ADD_TIME_SINCE(STATS_MICROS_RECEIVING, statsWaitStart);
+                STATS_COUNT(STATS_SERIAL_TIMEOUTS);
                 return 1;
             }
         }
+        STATS_ADD_TIME_SINCE(STATS_MICROS_RECEIVING, statsWaitStart);
     }
     n = _serial->read();
     return 0;
 }
 
-int SerialInterface::_readUint32WithTimeout(uint32_t& n)
+template <class MemoryChipType>
+int BasicSerialInterface<MemoryChipType>::_readUint32WithTimeout(uint32_t& n)
 {
     int errorCode;
     uint32_t x = 0;
@@ -67,22 +89,36 @@ int SerialInterface::_readUint32WithTimeout(uint32_t& n)
     return 0;
 }
 
+template <class MemoryChipType>
+int BasicSerialInterface<MemoryChipType>::_readUint16WithTimeout(uint16_t& n)
+{
+    int errorCode;
+    uint8_t high, low;
+    if ((errorCode = _readByteWithTimeout(high)) != 0) {return errorCode;}
+    if ((errorCode = _readByteWithTimeout(low)) != 0) {return errorCode;}
+    n = (static_cast<uint16_t>(high) << 8) | low;
+    return 0;
+}
+
 // I couuuuld turn these two into a template, but it's not quite worth
 // the structuring headache that C++ and the Arduino IDE impose together.
-void SerialInterface::_writeUint16(uint16_t n)
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_writeUint16(uint16_t n)
 {
     _serial->write(static_cast<uint8_t>(n >> 8));
     _serial->write(static_cast<uint8_t>(n));
 }
 
-void SerialInterface::_writeUint32(uint32_t n)
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_writeUint32(uint32_t n)
 {
     for (int shift = (sizeof(uint32_t) - 1) * 8; shift >= 0; shift -= 8) {
         _serial->write(static_cast<uint8_t>(n >> shift));
     }
 }
 
-bool SerialInterface::_checkForCommand()
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_checkForCommand()
 {
     if (_serial->available()) {
         uint8_t command = _serial->read();
@@ -106,14 +142,51 @@ bool SerialInterface::_checkForCommand()
             return _commandRead();
             break;
         case static_cast<uint8_t>(SerialCommand::WRITE):
-            return _commandWrite();
+            return _commandWrite(false);
+            break;
+        case static_cast<uint8_t>(SerialCommand::GET_AND_RESET_STATS):
+            _commandGetAndResetStats();
+            break;
+        case static_cast<uint8_t>(SerialCommand::RUN_MARCH_TEST):
+            _commandRunMarchTest();
+            break;
+        case static_cast<uint8_t>(SerialCommand::DIAGNOSE_LINES):
+            _commandDiagnoseLines();
+            break;
+        case static_cast<uint8_t>(SerialCommand::GET_ADDRESS_WIDTH):
+            // How big a chip the address channel can reach.
+            _serial->write(MemoryChipType::addressWidth());
+            break;
+        case static_cast<uint8_t>(SerialCommand::MEASURE_RETENTION):
+            _commandMeasureRetention();
+            break;
+        case static_cast<uint8_t>(SerialCommand::WRITE_CHANGED):
+            return _commandWrite(true);
+            break;
+        case static_cast<uint8_t>(SerialCommand::FILL):
+            _commandFill();
+            break;
+        case static_cast<uint8_t>(SerialCommand::GET_BLOCK_CHECKSUMS):
+            _commandGetBlockChecksums();
+            break;
+        case static_cast<uint8_t>(SerialCommand::GET_DIGEST):
+            _commandGetDigest();
+            break;
+        case static_cast<uint8_t>(SerialCommand::SET_BAUD_RATE):
+            _commandSetBaudRate();
             break;
         }
+        // (Commands that go on in _stateReading or _stateWriting count as
+        // finished when those do - see update.)
+        _lastCommandMillis = millis();
+    } else {
+        _revertBaudRateIfIdle();
     }
     return false;
 }
 
-bool SerialInterface::_commandSetAndAnalyzeChip()
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_commandSetAndAnalyzeChip()
 {
     MemoryChipKnownProperties receivedKnownProperties;
     MemoryChipProperties receivedProperties;
@@ -122,6 +195,7 @@ bool SerialInterface::_commandSetAndAnalyzeChip()
         return false;
     }
 
+    unsigned long int statsStart = STATS_TIMESTAMP();
     _turnMemoryOnTemporarily();
 
     _memoryChip->setProperties(&receivedKnownProperties,
@@ -131,12 +205,14 @@ bool SerialInterface::_commandSetAndAnalyzeChip()
                                &receivedProperties);
 
     _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_ANALYZING, statsStart);
     
     _sendMemoryChipProperties(receivedKnownProperties, receivedProperties);
     return false;
 }
 
-int SerialInterface::_receiveMemoryChipProperties(
+template <class MemoryChipType>
+int BasicSerialInterface<MemoryChipType>::_receiveMemoryChipProperties(
     MemoryChipKnownProperties& knownProperties,
     MemoryChipProperties& properties
 )
@@ -152,6 +228,12 @@ int SerialInterface::_receiveMemoryChipProperties(
     knownProperties.isNonVolatile = n;
     if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
     knownProperties.isSlow = n;
+    if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
+    knownProperties.powerOnSettleMicros = n;
+    if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
+    knownProperties.strobeMicros = n;
+    if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
+    knownProperties.usesDataProtection = n;
 
     if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
     properties.isOperational = n;
@@ -162,11 +244,19 @@ int SerialInterface::_receiveMemoryChipProperties(
     properties.isNonVolatile = n;
     if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
     properties.isSlow = n;
+    if ((errorCode = _readUint16WithTimeout(properties.powerOnSettleMicros)) != 0) {
+        return errorCode;
+    }
+    if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
+    properties.strobeMicros = n;
+    if ((errorCode = _readByteWithTimeout(n)) != 0) {return errorCode;}
+    properties.usesDataProtection = n;
 
     return 0;
 }
 
-void SerialInterface::_sendMemoryChipProperties(
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_sendMemoryChipProperties(
     MemoryChipKnownProperties &knownProperties,
     MemoryChipProperties &properties
 )
@@ -175,129 +265,226 @@ void SerialInterface::_sendMemoryChipProperties(
     _serial->write(knownProperties.size);
     _serial->write(knownProperties.isNonVolatile);
     _serial->write(knownProperties.isSlow);
+    _serial->write(knownProperties.powerOnSettleMicros);
+    _serial->write(knownProperties.strobeMicros);
+    _serial->write(knownProperties.usesDataProtection);
 
     _serial->write(properties.isOperational);
     _writeUint32(properties.size);
     _serial->write(properties.isNonVolatile);
     _serial->write(properties.isSlow);
+    _writeUint16(properties.powerOnSettleMicros);
+    _serial->write(properties.strobeMicros);
+    _serial->write(properties.usesDataProtection);
 }
 
-int SerialInterface::_readAddressAndSize(uint16_t& address, uint32_t& size)
+template <class MemoryChipType>
+int BasicSerialInterface<MemoryChipType>::_readAddressAndSize(
+    uint32_t& address, uint32_t& size)
 {
-    uint32_t address32Bits;
-
     int errorCode;
-    if ((errorCode = _readUint32WithTimeout(address32Bits)) != 0) {return errorCode;}
+    if ((errorCode = _readUint32WithTimeout(address)) != 0) {return errorCode;}
     if ((errorCode = _readUint32WithTimeout(size)) != 0) {return errorCode;}
 
     MemoryChipKnownProperties knownProperties;
     MemoryChipProperties properties;
     _memoryChip->getProperties(&knownProperties, &properties);
 
-    if (address32Bits > 0xFFFF) {
+    // Without a known size, the most there could be is whatever the address
+    // channel can reach.
+    uint32_t end = static_cast<uint32_t>(1) << MemoryChipType::addressWidth();
+    if (knownProperties.size && properties.size < end) {
+        end = properties.size;
+    }
+    if (address >= end) {
         size = 0;
         address = 0;
-    } else {
-        address = static_cast<uint16_t>(address32Bits);
-    }
-    if (knownProperties.size) {
-        if (address > properties.size - 1) {
-            size = 0;
-        } else if (properties.size - address < size) {
-            size = properties.size - address;
-        }
+    } else if (end - address < size) {
+        size = end - address;
     }
 
     return 0;
 }
 
-bool SerialInterface::_commandRead()
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_commandRead()
 {
+    _currentOperationStartedAt = STATS_TIMESTAMP();
     _turnMemoryOnTemporarily();
 
-    uint16_t address;
+    uint32_t address;
     uint32_t size;
+    uint8_t encoding;
     if (_readAddressAndSize(address, size) != 0) {return false;}
+    if (_readByteWithTimeout(encoding) != 0) {return false;}
+    // Compressing needs somewhere to put the frame. If something else has
+    // the scratch buffer, it just doesn't get compressed.
+    if (encoding == static_cast<uint8_t>(FrameEncoding::COMPRESSED)) {
+        _frameBuffer = borrowScratchBuffer();
+    }
+    _isCompressingFrames = _frameBuffer != NULL;
     _writeUint32(size);
-    
-    _currentOperationStart = address;
-    _currentAddress = address;
-    _currentOperationSize = size;
-    _currentBytesLeft = size;
-    _currentCrc32.reset();
+    _serial->write(static_cast<uint8_t>(FRAMUNE_READ_WINDOW));
+    _serial->write(static_cast<uint8_t>(_isCompressingFrames ?
+                                        FrameEncoding::COMPRESSED : FrameEncoding::RAW));
+
+    _beginFrames(address, size, FRAMUNE_READ_WINDOW);
     _memoryChip->switchToReadMode();
+    // The whole read is one block, so the address channel only has to
+    // be set up once. Ended in _endReading.
+    _memoryChip->beginBlock();
     _state = SerialState::READING;
 
     return true;
 }
 
-bool SerialInterface::_stateReading()
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_stateReading()
 {
-    if (_currentBytesLeft) {
-        uint8_t n = _memoryChip->readByte(_currentAddress);
-        _currentCrc32.update(n);
-        _serial->write(n);
-        _currentAddress++;
-        _currentBytesLeft--;
-        return true;
-    } else {
-        _returnMemoryPowerState();
-        _writeUint32(_currentCrc32.finalize());
-        _state = SerialState::WAITING_FOR_COMMAND;
+    FrameMarker marker;
+    uint8_t sequence;
+    uint32_t index;
+    while (_receiveControl(marker, sequence)) {
+        // ACKs and NAKs for frames that haven't even been sent yet are
+        // garbage that happened to check out.
+        if (!_frameIndex(sequence, index) || index >= _frameNext) {
+            continue;
+        }
+        if (marker == FrameMarker::ACK) {
+            _markFrameDone(index);
+        } else if (marker == FrameMarker::NAK) {
+            _framesToResend |= static_cast<uint16_t>(1) << (index - _frameBase);
+            _frameProgressMillis = millis();
+        }
+    }
+
+    if (_frameBase == _frameCount) {
+        _finishFrames();
+        _endReading();
         return false;
     }
+    if (_framesToResend) {
+        uint8_t offset = 0;
+        while (!(_framesToResend & (static_cast<uint16_t>(1) << offset))) {
+            offset++;
+        }
+        _framesToResend &= ~(static_cast<uint16_t>(1) << offset);
+        STATS_COUNT(STATS_FRAMES_RESENT);
+        _sendFrame(_frameBase + offset);
+    } else if (_frameNext < _frameCount && _frameNext - _frameBase < _frameWindow) {
+        _sendFrame(_frameNext++);
+    } else if (millis() - _frameProgressMillis >= FRAMUNE_FRAME_TIMEOUT_MILLIS) {
+        // Nothing's been heard of the frames in the window for a while, so
+        // either they or their ACKs got lost. Either way, off they go again.
+        if (++_frameTimeouts > FRAMUNE_FRAME_MAX_TIMEOUTS) {
+            _endReading();
+            return false;
+        }
+        uint8_t inFlight = _frameNext - _frameBase;
+        _framesToResend = ~_framesDone & ((static_cast<uint32_t>(1) << inFlight) - 1);
+        _frameProgressMillis = millis();
+    }
+    return true;
 }
 
-bool SerialInterface::_commandWrite()
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_endReading()
 {
-    _turnMemoryOnTemporarily();
+    if (_frameBuffer) {
+        returnScratchBuffer();
+        _frameBuffer = NULL;
+    }
+    _memoryChip->endBlock();
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_READING, _currentOperationStartedAt);
+    _state = SerialState::WAITING_FOR_COMMAND;
+}
 
-    MemoryChipKnownProperties knownProperties;
-    MemoryChipProperties properties;
-    _memoryChip->getProperties(&knownProperties, &properties);
-    // Unused at the moment.
-    _serial->write(knownProperties.isSlow && properties.isSlow);
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_commandWrite(bool isWritingChangesOnly)
+{
+    _currentOperationStartedAt = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
 
-    uint16_t address;
+    uint32_t address;
     uint32_t size;
+    uint8_t encoding;
     if (_readAddressAndSize(address, size) != 0) {return false;}
+    if (_readByteWithTimeout(encoding) != 0) {return false;}
+    // Frames have to be checked before they're written, so they need
+    // somewhere to wait - see FRAMUNE_FRAME_SLOTS.
+    _frameBuffer = borrowScratchBuffer();
+    _frameSlotsUsed = 0;
+    if (!_frameBuffer) {
+        size = 0;
+    }
+    _isCompressingFrames = encoding == static_cast<uint8_t>(FrameEncoding::COMPRESSED);
     _writeUint32(size);
+    _serial->write(static_cast<uint8_t>(FRAMUNE_WRITE_WINDOW));
+    _serial->write(static_cast<uint8_t>(_isCompressingFrames ?
+                                        FrameEncoding::COMPRESSED : FrameEncoding::RAW));
 
-    _currentOperationStart = address;
-    _currentAddress = address;
-    _currentOperationSize = size;
-    _currentBytesLeft = size;
-    _currentCrc32.reset();
+    _beginFrames(address, size, FRAMUNE_WRITE_WINDOW);
+    _isWritingChangesOnly = isWritingChangesOnly;
+    _currentBytesChanged = 0;
     _memoryChip->switchToWriteMode();
+    // Same as in _commandRead. Ended in _stateWriting.
+    _memoryChip->beginBlock();
     _state = SerialState::WRITING;
 
     return true;
 }
 
-bool SerialInterface::_stateWriting()
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_stateWriting()
 {
-    if (_currentBytesLeft) {
-        uint8_t n;
-        if (_readByteWithTimeout(n) != 0) {
-            _state = SerialState::WAITING_FOR_COMMAND;
+    bool isReceiving = _takeInFrames();
+    if (_frameSlotsUsed) {
+        // One frame per call, so the frames coming in in the meantime get
+        // taken out of the receive buffer (and ACKed) before it fills up.
+        uint8_t slot = 0;
+        while (!(_frameSlotsUsed & (1 << slot))) {
+            slot++;
+        }
+        uint32_t index = _frameSlotIndices[slot];
+        uint32_t start;
+        uint32_t end;
+        _frameRange(index, start, end);
+        _currentAddress = start;
+        uint8_t* frame = _frameBuffer + slot * FRAMUNE_FRAME_SLOT_SIZE;
+        if (_writeBytes(frame + 2 + start % FRAMUNE_FRAME_SIZE, end - start) != end - start) {
+            // There's no point in going on, and no CRC either. Whatever
+            // frames are still on their way aren't commands!
+            _sendControl(FrameMarker::CANCEL, index);
+            _discardInput();
+            _abortWriting();
+            return false;
+        }
+        _frameSlotsUsed &= ~(1 << slot);
+        _frameProgressMillis = millis();
+        return true;
+    }
+    if (_frameBase < _frameCount) {
+        // The host sends frames again when they aren't ACKed, so there's
+        // nothing to do but wait - unless it's been too long.
+        if (!isReceiving && millis() - _frameProgressMillis >=
+                FRAMUNE_FRAME_TIMEOUT_MILLIS * FRAMUNE_FRAME_MAX_TIMEOUTS) {
+            _abortWriting();
             return false;
         }
-        _memoryChip->writeByte(_currentAddress, n);
-        _currentAddress++;
-        _currentBytesLeft--;
         return true;
     } else {
-        _memoryChip->switchToReadMode();
-        uint32_t end = _currentOperationStart + _currentOperationSize;
-        bool all_bytes_seem_pulled = true;
-        for (uint32_t address = _currentOperationStart; address < end; address++) {
-            uint8_t n = _memoryChip->readByte(address);
-            _currentCrc32.update(n);
-            if (n != 0xFF && n != 0x00) {
-                all_bytes_seem_pulled = false;
-            }
+        _finishFrames();
+        if (_frameBuffer) {
+            returnScratchBuffer();
+            _frameBuffer = NULL;
         }
-        _writeUint32(_currentCrc32.finalize());
+        unsigned long int statsStart = STATS_TIMESTAMP();
+        STATS_ADD(STATS_MICROS_WRITING, statsStart - _currentOperationStartedAt);
+        bool all_bytes_seem_pulled;
+        _writeUint32(_readBackCrc32(_currentOperationStart, _currentOperationSize,
+                                    all_bytes_seem_pulled));
+        STATS_ADD_TIME_SINCE(STATS_MICROS_VERIFYING, statsStart);
 
         // If all the bytes written were 0x00 or 0xFF, and the data lines have
         // pull-downs or pull-ups (respectively) on them, it's impossible to
@@ -305,6 +492,7 @@ bool SerialInterface::_stateWriting()
         // an extra write like this.
         uint8_t errorCode = 0;
         if (all_bytes_seem_pulled) {
+            statsStart = STATS_TIMESTAMP();
             _memoryChip->switchToReadMode();
             uint8_t prevByte = _memoryChip->readByte(_currentOperationStart);
             _memoryChip->switchToWriteMode();
@@ -315,12 +503,702 @@ bool SerialInterface::_stateWriting()
             }
             _memoryChip->switchToWriteMode();
             _memoryChip->writeByte(_currentOperationStart, prevByte);
+            STATS_ADD_TIME_SINCE(STATS_MICROS_PULL_UP_CHECK, statsStart);
         }
         _serial->write(errorCode);
+        if (_isWritingChangesOnly) {
+            _writeUint32(_currentBytesChanged);
+        }
 
+        _memoryChip->endBlock();
         _returnMemoryPowerState();
 
         _state = SerialState::WAITING_FOR_COMMAND;
         return false;
     }
 }
+
+// Reads back what was just written (or whatever's there), for its CRC.
+// Leaves the bus in read mode.
+template <class MemoryChipType>
+uint32_t BasicSerialInterface<MemoryChipType>::_readBackCrc32(
+    uint32_t address, uint32_t size, bool& allBytesSeemPulled)
+{
+    _memoryChip->switchToReadMode();
+    _currentCrc32.reset();
+    uint32_t end = address + size;
+    allBytesSeemPulled = true;
+    if (address < end) {
+        _memoryChip->beginReadByte(address);
+    }
+    for (; address < end; address++) {
+        uint8_t n = _memoryChip->completeReadByte();
+        if (address + 1 < end) {
+            _memoryChip->beginReadByte(address + 1);
+        }
+        _currentCrc32.update(n);
+        if (n != 0xFF && n != 0x00) {
+            allBytesSeemPulled = false;
+        }
+    }
+    return _currentCrc32.finalize();
+}
+
+// Takes in frames for as long as there are some waiting and slots free to
+// put them in. Returns whether anything came in at all.
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_takeInFrames()
+{
+    bool isReceiving = false;
+    int8_t slot;
+    // After the last one, there's only the FIN, which _finishFrames wants.
+    while (_frameBase < _frameCount && (slot = _freeFrameSlot()) >= 0) {
+        uint8_t* frame = _frameBuffer + slot * FRAMUNE_FRAME_SLOT_SIZE;
+        uint8_t sequence;
+        FrameStatus status = _receiveFrame(frame, sequence);
+        if (status == FrameStatus::NONE || status == FrameStatus::UNNUMBERED) {
+            break;
+        }
+        isReceiving = true;
+        uint32_t index;
+        bool isInWindow = _frameIndex(sequence, index);
+        if (status == FrameStatus::DAMAGED) {
+            if (isInWindow) {
+                STATS_COUNT(STATS_FRAMES_RESENT);
+                _sendControl(FrameMarker::NAK, sequence);
+            }
+            continue;
+        }
+        // Anything intact from outside the window is one that's already
+        // been taken in, sent again because its ACK got lost.
+        _frameProgressMillis = millis();
+        if (isInWindow &&
+            !(_framesDone & (static_cast<uint16_t>(1) << (index - _frameBase)))) {
+            _frameSlotIndices[slot] = index;
+            _frameSlotsUsed |= 1 << slot;
+            _markFrameDone(index);
+        }
+        _sendControl(FrameMarker::ACK, sequence);
+    }
+    return isReceiving;
+}
+
+template <class MemoryChipType>
+int8_t BasicSerialInterface<MemoryChipType>::_freeFrameSlot()
+{
+    for (uint8_t slot = 0; slot < FRAMUNE_FRAME_SLOTS; slot++) {
+        if (!(_frameSlotsUsed & (1 << slot))) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+template <class MemoryChipType>
+size_t BasicSerialInterface<MemoryChipType>::_writeBytes(uint8_t* source, size_t length)
+{
+    if (_isWritingChangesOnly) {
+        return _memoryChip->writeChangedBytes(_currentAddress, source, length,
+                                              &_currentBytesChanged);
+    }
+    if (length == 1) {
+        _memoryChip->writeByte(_currentAddress, *source);
+        return 1;
+    }
+    return _memoryChip->writeBytes(_currentAddress, source, length);
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_abortWriting()
+{
+    _memoryChip->endBlock();
+    if (_frameBuffer) {
+        returnScratchBuffer();
+        _frameBuffer = NULL;
+    }
+    STATS_ADD_TIME_SINCE(STATS_MICROS_WRITING, _currentOperationStartedAt);
+    _returnMemoryPowerState();
+    _state = SerialState::WAITING_FOR_COMMAND;
+}
+
+// Frames: FrameMarker::START, the frame's sequence number (its index, mod
+// 256) and the sequence number's complement, FRAMUNE_FRAME_SIZE bytes of
+// data, and the CRC32 of the sequence number and the data. They line up
+// with multiples of FRAMUNE_FRAME_SIZE in the address space, so that they
+// don't straddle EEPROM pages - which means the first and last ones can
+// stick out of the transfer at either end. Those bytes are sent as 0, and
+// ignored. The receiver answers every frame with an ACK or a NAK: the
+// marker, the sequence number, and its complement again. Once everything's
+// been ACKed, the F-Ramune sends END (with the frame count as the sequence
+// number), and the host answers with FIN.
+//
+// If the host asked for FrameEncoding::COMPRESSED, the data's compressed
+// (see framecompression.hpp), with its length in a byte in front of it -
+// or FRAMUNE_FRAME_SIZE, and the data as it is, if that didn't make it any
+// shorter. The CRC's still of the data as it is, either way.
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_beginFrames(
+    uint32_t address, uint32_t size, uint8_t window)
+{
+    _currentOperationStart = address;
+    _currentOperationSize = size;
+    uint32_t firstFrameAddress = address - address % FRAMUNE_FRAME_SIZE;
+    _frameCount = 0;
+    if (size) {
+        _frameCount = (address + size - firstFrameAddress + FRAMUNE_FRAME_SIZE - 1) /
+                      FRAMUNE_FRAME_SIZE;
+    }
+    _frameBase = 0;
+    _frameNext = 0;
+    _frameWindow = window;
+    _framesDone = 0;
+    _framesToResend = 0;
+    _frameProgressMillis = millis();
+    _frameTimeouts = 0;
+}
+
+// The addresses of the part of a frame that's in the transfer.
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_frameRange(
+    uint32_t index, uint32_t& start, uint32_t& end)
+{
+    uint32_t transferEnd = _currentOperationStart + _currentOperationSize;
+    start = _currentOperationStart - _currentOperationStart % FRAMUNE_FRAME_SIZE +
+            index * FRAMUNE_FRAME_SIZE;
+    end = start + FRAMUNE_FRAME_SIZE;
+    if (start < _currentOperationStart) {
+        start = _currentOperationStart;
+    }
+    if (end > transferEnd) {
+        end = transferEnd;
+    }
+}
+
+// Which frame in the window a sequence number is for - or false, if it
+// isn't for one in the window.
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_frameIndex(
+    uint8_t sequence, uint32_t& index)
+{
+    uint8_t offset = sequence - static_cast<uint8_t>(_frameBase);
+    index = _frameBase + offset;
+    return offset < _frameWindow && index < _frameCount;
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_markFrameDone(uint32_t index)
+{
+    uint16_t bit = static_cast<uint16_t>(1) << (index - _frameBase);
+    _framesDone |= bit;
+    _framesToResend &= ~bit;
+    // The window moves up past everything that's done at the bottom of it.
+    while (_framesDone & 1) {
+        _framesDone >>= 1;
+        _framesToResend >>= 1;
+        _frameBase++;
+    }
+    _frameProgressMillis = millis();
+    _frameTimeouts = 0;
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_sendFrame(uint32_t index)
+{
+    uint32_t start;
+    uint32_t end;
+    _frameRange(index, start, end);
+    uint8_t sequence = index;
+    _serial->write(static_cast<uint8_t>(FrameMarker::START));
+    _serial->write(sequence);
+    _serial->write(static_cast<uint8_t>(~sequence));
+
+    CRC32 crc;
+    crc.update(sequence);
+    uint32_t address = start - start % FRAMUNE_FRAME_SIZE;
+    _memoryChip->beginReadByte(start);
+    for (uint8_t i = 0; i < FRAMUNE_FRAME_SIZE; i++, address++) {
+        uint8_t n = 0;
+        if (address >= start && address < end) {
+            // The next byte's address shifts out while this one's CRC is
+            // computed and it's sent off (or put aside for compressing).
+            n = _memoryChip->completeReadByte();
+            if (address + 1 < end) {
+                _memoryChip->beginReadByte(address + 1);
+            }
+        }
+        crc.update(n);
+        if (_isCompressingFrames) {
+            _frameBuffer[i] = n;
+        } else {
+            _serial->write(n);
+        }
+    }
+    if (_isCompressingFrames) {
+        // Compressed frames say how long they are. FRAMUNE_FRAME_SIZE means
+        // it didn't come out any shorter, so it's sent as it is.
+        uint8_t* compressed = _frameBuffer + FRAMUNE_FRAME_SIZE;
+        uint8_t length = compressFrame(_frameBuffer, FRAMUNE_FRAME_SIZE, compressed);
+        _serial->write(length);
+        _serial->write(length < FRAMUNE_FRAME_SIZE ? compressed : _frameBuffer, length);
+    }
+    _writeUint32(crc.finalize());
+}
+
+// Takes in a frame, if one's there, into a frame slot: the sequence number,
+// its complement, the data, and the CRC.
+template <class MemoryChipType>
+typename BasicSerialInterface<MemoryChipType>::FrameStatus
+BasicSerialInterface<MemoryChipType>::_receiveFrame(uint8_t* frame, uint8_t& sequence)
+{
+    // Whatever isn't the start of a frame is what's left of a damaged one.
+    while (_serial->available() &&
+           _serial->peek() != static_cast<uint8_t>(FrameMarker::START)) {
+        _serial->read();
+    }
+    if (!_serial->available()) {
+        return FrameStatus::NONE;
+    }
+    _serial->read();
+
+    // The rest of it comes in right behind the start, so it doesn't get
+    // long to do it.
+    unsigned long int startedAt = millis();
+    if (_receiveFrameBytes(frame, 2, startedAt) < 2 ||
+        frame[1] != static_cast<uint8_t>(~frame[0])) {
+        // Some data that just looked like a start, most likely.
+        return FrameStatus::UNNUMBERED;
+    }
+    sequence = frame[0];
+
+    // A compressed frame comes in after the slots, and gets expanded into
+    // its own. (Unless its length says it didn't compress.)
+    uint8_t* data = frame + 2;
+    uint8_t* payload = data;
+    uint8_t payloadLength = FRAMUNE_FRAME_SIZE;
+    if (_isCompressingFrames) {
+        if (_receiveFrameBytes(&payloadLength, 1, startedAt) < 1 ||
+            payloadLength == 0 || payloadLength > FRAMUNE_FRAME_SIZE) {
+            return FrameStatus::DAMAGED;
+        }
+        if (payloadLength < FRAMUNE_FRAME_SIZE) {
+            payload = _frameBuffer + FRAMUNE_FRAME_SLOTS * FRAMUNE_FRAME_SLOT_SIZE;
+        }
+    }
+    if (_receiveFrameBytes(payload, payloadLength + 4, startedAt) < payloadLength + 4) {
+        return FrameStatus::DAMAGED;
+    }
+    if (payload != data && !expandFrame(payload, payloadLength, data, FRAMUNE_FRAME_SIZE)) {
+        return FrameStatus::DAMAGED;
+    }
+
+    // Of the data as it's written, compressed or not.
+    CRC32 crc;
+    crc.update(sequence);
+    crc.update(data, FRAMUNE_FRAME_SIZE);
+    uint32_t receivedCrc = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        receivedCrc = receivedCrc << 8 | payload[payloadLength + i];
+    }
+    return crc.finalize() == receivedCrc ? FrameStatus::INTACT : FrameStatus::DAMAGED;
+}
+
+// Returns how many of the bytes came in before the frame timed out.
+template <class MemoryChipType>
+uint8_t BasicSerialInterface<MemoryChipType>::_receiveFrameBytes(
+    uint8_t* dest, uint8_t length, unsigned long int startedAt)
+{
+    uint8_t received = 0;
+    while (received < length) {
+        if (!_serial->available()) {
+            if (millis() - startedAt >= FRAMUNE_FRAME_TIMEOUT_MILLIS) {
+                break;
+            }
+            continue;
+        }
+        dest[received++] = _serial->read();
+    }
+    return received;
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_sendControl(
+    FrameMarker marker, uint8_t sequence)
+{
+    _serial->write(static_cast<uint8_t>(marker));
+    _serial->write(sequence);
+    _serial->write(static_cast<uint8_t>(~sequence));
+}
+
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_isControl(int n)
+{
+    return n >= static_cast<uint8_t>(FrameMarker::CANCEL) &&
+           n <= static_cast<uint8_t>(FrameMarker::FIN) &&
+           n != static_cast<uint8_t>(FrameMarker::START);
+}
+
+// True if an intact ACK, NAK or such was there. Skips over anything that
+// isn't one, and leaves the last one alone if it hasn't all come in yet.
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_receiveControl(
+    FrameMarker& marker, uint8_t& sequence)
+{
+    while (_serial->available()) {
+        if (!_isControl(_serial->peek())) {
+            _serial->read();
+            continue;
+        }
+        if (_serial->available() < 3) {
+            return false;
+        }
+        marker = static_cast<FrameMarker>(_serial->read());
+        sequence = _serial->read();
+        if (_serial->read() == static_cast<uint8_t>(~sequence)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sends END, and waits for the host's FIN. Until then, any frame the host
+// sends again (because it missed the END, or an ACK) gets END again, and
+// ACKs for frames that came in twice get ignored. If the FIN gets lost,
+// it's over anyway after a while - or as soon as something else comes in,
+// which has to be the next command.
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_finishFrames()
+{
+    uint8_t sequence = _frameCount;
+    _sendControl(FrameMarker::END, sequence);
+    unsigned long int sentAt = millis();
+    uint8_t timeouts = 0;
+    while (true) {
+        if (millis() - sentAt >= FRAMUNE_FRAME_TIMEOUT_MILLIS) {
+            if (++timeouts >= FRAMUNE_FRAME_MAX_TIMEOUTS) {
+                return;
+            }
+            _sendControl(FrameMarker::END, sequence);
+            sentAt = millis();
+        }
+        int n = _serial->peek();
+        if (n < 0) {
+            continue;
+        }
+        if (n == static_cast<uint8_t>(FrameMarker::START)) {
+            uint8_t repeatedSequence;
+            if (_frameBuffer) {
+                // The slots are all free by now.
+                _receiveFrame(_frameBuffer, repeatedSequence);
+            } else {
+                _serial->read();
+            }
+            _sendControl(FrameMarker::END, sequence);
+            sentAt = millis();
+            continue;
+        }
+        if (!_isControl(n)) {
+            return;
+        }
+        FrameMarker marker;
+        uint8_t controlSequence;
+        if (_receiveControl(marker, controlSequence) && marker == FrameMarker::FIN) {
+            return;
+        }
+    }
+}
+
+// Throws away everything coming in, until nothing has for a while.
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_discardInput()
+{
+    unsigned long int lastByteAt = millis();
+    while (millis() - lastByteAt < FRAMUNE_FRAME_TIMEOUT_MILLIS) {
+        if (_serial->available()) {
+            _serial->read();
+            lastByteAt = millis();
+        }
+    }
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandGetAndResetStats()
+{
+    // Whether the counters are compiled in, followed by how many there are
+    // (so that framune.py can cope with a device that has more or fewer),
+    // followed by the counters themselves.
+    _serial->write(static_cast<uint8_t>(STATS_ENABLED));
+#if STATS_ENABLED
+    _serial->write(static_cast<uint8_t>(STATS_NUM_COUNTERS));
+    STATS[STATS_STACK_BYTES_NEVER_USED] = unusedStackBytes();
+    for (uint8_t i = 0; i < STATS_NUM_COUNTERS; i++) {
+        _writeUint32(STATS[i]);
+    }
+    resetStats();
+#else
+    _serial->write(static_cast<uint8_t>(0));
+#endif
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandRunMarchTest()
+{
+    uint8_t algorithmId;
+    if (_readByteWithTimeout(algorithmId) != 0) {return;}
+    uint32_t address;
+    uint32_t size;
+    if (_readAddressAndSize(address, size) != 0) {return;}
+
+    MarchAlgorithm algorithm;
+    bool algorithmExists = getMarchAlgorithm(algorithmId, &algorithm);
+    _serial->write(algorithmExists);
+    if (!algorithmExists) {return;}
+    // Enough for framune.py to tell how long to wait for the results.
+    _writeUint32(size);
+    _writeUint16(algorithm.coverage);
+    _serial->write(marchOperationsPerCell(algorithm));
+
+    unsigned long int statsStart = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
+    MarchTestResult result;
+    _memoryChip->runMarchTest(algorithm, address, address + size, &result, NULL);
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_TESTING, statsStart);
+
+    _serial->write(result.passed);
+    _writeUint32(result.mismatches);
+    _writeUint32(result.firstMismatchAddress);
+    _writeUint16(result.failedElements);
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandDiagnoseLines()
+{
+    uint8_t addressWidth;
+    if (_readByteWithTimeout(addressWidth) != 0) {return;}
+
+    unsigned long int statsStart = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
+    MemoryChipLineDiagnosis diagnosis;
+    bool diagnosed = _memoryChip->diagnoseLines(addressWidth, &diagnosis);
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_TESTING, statsStart);
+
+    _serial->write(diagnosed);
+    if (!diagnosed) {return;}
+    _serial->write(diagnosis.dataStuckLow);
+    _serial->write(diagnosis.dataStuckHigh);
+    _serial->write(diagnosis.dataShorted);
+    _serial->write(diagnosis.addressWidth);
+    _serial->write(diagnosis.addressesTested);
+    _writeUint32(diagnosis.addressStuck);
+    _writeUint32(diagnosis.addressShorted);
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandFill()
+{
+    uint8_t patternId;
+    if (_readByteWithTimeout(patternId) != 0) {return;}
+    uint32_t seed;
+    if (_readUint32WithTimeout(seed) != 0) {return;}
+    uint32_t address;
+    uint32_t size;
+    if (_readAddressAndSize(address, size) != 0) {return;}
+
+    FillPattern pattern;
+    bool patternExists = initFillPattern(patternId, seed, address, &pattern);
+    _serial->write(patternExists);
+    if (!patternExists) {return;}
+    _writeUint32(size);
+
+    unsigned long int statsStart = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
+    _memoryChip->switchToWriteMode();
+    _memoryChip->beginBlock();
+    // A buffer's worth at a time, so that writeBytes gets to do its thing -
+    // EEPROMs get whole pages. Without the buffer, it's a byte at a time.
+    uint8_t* buffer = borrowScratchBuffer();
+    bool isWritten = true;
+    uint32_t end = address + size;
+    for (uint32_t chunkStart = address; chunkStart < end;) {
+        if (!buffer) {
+            uint8_t n;
+            fillPatternBytes(&pattern, &n, 1);
+            _memoryChip->writeByte(chunkStart, n);
+            chunkStart++;
+            continue;
+        }
+        size_t length = end - chunkStart < SCRATCH_BUFFER_SIZE ?
+                        end - chunkStart : SCRATCH_BUFFER_SIZE;
+        fillPatternBytes(&pattern, buffer, length);
+        if (_memoryChip->writeBytes(chunkStart, buffer, length) != length) {
+            isWritten = false;
+            break;
+        }
+        chunkStart += length;
+    }
+    if (buffer) {
+        returnScratchBuffer();
+    }
+    STATS_ADD_TIME_SINCE(STATS_MICROS_WRITING, statsStart);
+
+    statsStart = STATS_TIMESTAMP();
+    bool allBytesSeemPulled;
+    uint32_t crc = _readBackCrc32(address, size, allBytesSeemPulled);
+    _memoryChip->endBlock();
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_VERIFYING, statsStart);
+
+    _serial->write(isWritten);
+    _writeUint32(crc);
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandGetBlockChecksums()
+{
+    uint16_t blockSize;
+    if (_readUint16WithTimeout(blockSize) != 0) {return;}
+    uint32_t address;
+    uint32_t size;
+    if (_readAddressAndSize(address, size) != 0) {return;}
+    _serial->write(blockSize != 0);
+    if (!blockSize) {return;}
+    _writeUint32(size);
+
+    // A CRC for every block, sent off as soon as it's done - so a chip can
+    // be compared to an image with one pass over it, and only 4 bytes per
+    // block over serial. The last block may be shorter than the rest.
+    unsigned long int statsStart = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
+    _memoryChip->switchToReadMode();
+    _memoryChip->beginBlock();
+    CRC32 crc;
+    uint32_t end = address + size;
+    uint16_t blockBytesLeft = blockSize;
+    if (address < end) {
+        _memoryChip->beginReadByte(address);
+    }
+    for (; address < end; address++) {
+        uint8_t n = _memoryChip->completeReadByte();
+        if (address + 1 < end) {
+            _memoryChip->beginReadByte(address + 1);
+        }
+        crc.update(n);
+        if (!--blockBytesLeft || address + 1 == end) {
+            _writeUint32(crc.finalize());
+            crc.reset();
+            blockBytesLeft = blockSize;
+        }
+    }
+    _memoryChip->endBlock();
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_READING, statsStart);
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandGetDigest()
+{
+    uint32_t address;
+    uint32_t size;
+    if (_readAddressAndSize(address, size) != 0) {return;}
+    _writeUint32(size);
+
+    // Just the CRC, for checking a chip against an image without sending
+    // the image's worth of bytes.
+    unsigned long int statsStart = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
+    _memoryChip->beginBlock();
+    bool allBytesSeemPulled;
+    uint32_t crc = _readBackCrc32(address, size, allBytesSeemPulled);
+    _memoryChip->endBlock();
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_READING, statsStart);
+    _writeUint32(crc);
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandMeasureRetention()
+{
+    unsigned long int statsStart = STATS_TIMESTAMP();
+    _turnMemoryOnTemporarily();
+    MemoryChipRetentionPoint points[MEMORY_CHIP_RETENTION_STEPS];
+    uint16_t numSamples = _memoryChip->measureRetention(points);
+    _returnMemoryPowerState();
+    STATS_ADD_TIME_SINCE(STATS_MICROS_TESTING, statsStart);
+
+    _writeUint16(numSamples);
+    if (!numSamples) {return;}
+    _serial->write(static_cast<uint8_t>(MEMORY_CHIP_RETENTION_STEPS));
+    for (uint8_t i = 0; i < MEMORY_CHIP_RETENTION_STEPS; i++) {
+        _writeUint32(points[i].offMicros);
+        _writeUint16(points[i].decayedCells);
+    }
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_commandSetBaudRate()
+{
+    uint32_t baudRate;
+    if (_readUint32WithTimeout(baudRate) != 0) {return;}
+    bool isPossible = _setBaudRate && baudRate && _setBaudRate(baudRate, false);
+    _serial->write(static_cast<uint8_t>(isPossible));
+    if (!isPossible) {return;}
+
+    // The OK has to get out at the old baud rate. After that, the host
+    // switches too, and sends the check sequence at the new one - if that
+    // doesn't come through, it's back to the old one, and the host will
+    // figure that out by not getting the sequence echoed back.
+    _serial->flush();
+    if (!_setBaudRate(baudRate, true)) {return;}
+    if (_receiveBaudRateCheck()) {
+        _baudRate = baudRate;
+    } else {
+        _setBaudRate(_baudRate, true);
+    }
+}
+
+template <class MemoryChipType>
+bool BasicSerialInterface<MemoryChipType>::_receiveBaudRateCheck()
+{
+    static const uint8_t checkSequence[] = {0x55, 0xAA, 0xF0, 0x0F};
+    // Whatever came in while the host was switching over is garbage,
+    // so skip ahead to the sequence.
+    uint8_t matched = 0;
+    unsigned long int startedWaiting = millis();
+    while (matched < sizeof(checkSequence)) {
+        if (millis() - startedWaiting >= FRAMUNE_BAUD_RATE_CHECK_MILLIS) {
+            return false;
+        }
+        int n = _serial->read();
+        if (n < 0) {
+            continue;
+        }
+        if (n == checkSequence[matched]) {
+            matched++;
+        } else {
+            matched = n == checkSequence[0];
+        }
+    }
+    _serial->write(checkSequence, sizeof(checkSequence));
+    _serial->flush();
+    return true;
+}
+
+template <class MemoryChipType>
+void BasicSerialInterface<MemoryChipType>::_revertBaudRateIfIdle()
+{
+    if (_baudRate == FRAMUNE_DEFAULT_BAUD_RATE ||
+        millis() - _lastCommandMillis < FRAMUNE_BAUD_RATE_IDLE_MILLIS) {
+        return;
+    }
+    if (_setBaudRate(FRAMUNE_DEFAULT_BAUD_RATE, true)) {
+        _baudRate = FRAMUNE_DEFAULT_BAUD_RATE;
+    }
+}
+
+#else
+// Non-template implementations.
+#include "serialinterface.hpp"
+
+#endif
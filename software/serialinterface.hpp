@@ -3,19 +3,82 @@
 
 #include <Arduino.h>
 #include <CRC32.h>
+#include "fillpattern.hpp"
+#include "framecompression.hpp"
 #include "memorychip.hpp"
+#include "scratch.hpp"
+#include "stats.hpp"
 
-#define FRAMUNE_PROTOCOL_VERSION 0
+#define FRAMUNE_PROTOCOL_VERSION 14
 
-class SerialInterface
+// The baud rate everything starts out at, and goes back to when the host
+// hasn't said anything in FRAMUNE_BAUD_RATE_IDLE_MILLIS after switching to
+// another one with SET_BAUD_RATE - say, because framune.py got killed
+// before it could switch back. It has to match BAUD_RATE in framune.py.
+#define FRAMUNE_DEFAULT_BAUD_RATE 115200
+#ifndef FRAMUNE_BAUD_RATE_IDLE_MILLIS
+#define FRAMUNE_BAUD_RATE_IDLE_MILLIS 5000
+#endif
+// How long the host gets to send the check sequence at the new baud rate,
+// before it's considered a failure and the old one is switched back to.
+#define FRAMUNE_BAUD_RATE_CHECK_MILLIS 250
+
+// Whatever owns the serial port provides one of these for SET_BAUD_RATE.
+// With isSwitching false, it just says whether baudRate is one it can do;
+// with isSwitching true, it actually switches to it (everything written
+// before has been flushed by then). Returns false if it can't.
+typedef bool (*SerialBaudRateFunction)(uint32_t baudRate, bool isSwitching);
+
+// READ, WRITE and WRITE_CHANGED send the data in frames of this many bytes,
+// each with its own CRC, so that only the frames that get garbled on the
+// way have to be sent again. See _sendFrame for what they look like.
+#define FRAMUNE_FRAME_SIZE 64
+// The most bytes a frame can take on the wire: a compressed one that didn't
+// compress, with its length byte.
+#define FRAMUNE_MAX_FRAME_LENGTH (4 + FRAMUNE_FRAME_SIZE + 4)
+// How many frames can be on their way at once, before the first of them
+// has been acknowledged. For writes, that many have to fit in the serial
+// port's receive buffer, since the host can send them all while the frame
+// slots are full. (16 at most.)
+#define FRAMUNE_READ_WINDOW 16
+#define FRAMUNE_WRITE_WINDOW 3
+// How long a frame goes unacknowledged before it's sent again (or, for
+// writes, how long one can take to come in), and how many times in a row
+// that can happen before the host's considered gone.
+#define FRAMUNE_FRAME_TIMEOUT_MILLIS 200
+#define FRAMUNE_FRAME_MAX_TIMEOUTS 10
+
+// Frames being written wait in slots in the scratch buffer: the sequence
+// number and its complement, the data, and the CRC. A frame's ACKed as soon
+// as it's in a slot, so the host can send the next ones while it's being
+// written - and as long as there's no slot free, the rest stay in the
+// serial port's receive buffer, unacknowledged, so the host stops at the
+// window. One slot's worth more goes to compressed frames, which come in
+// there before they're expanded into their slot.
+#define FRAMUNE_FRAME_SLOT_SIZE (2 + FRAMUNE_FRAME_SIZE + 4)
+#define FRAMUNE_FRAME_SLOTS (SCRATCH_BUFFER_SIZE / FRAMUNE_FRAME_SLOT_SIZE - 1 < 8 ? \
+                             SCRATCH_BUFFER_SIZE / FRAMUNE_FRAME_SLOT_SIZE - 1 : 8)
+
+static_assert(FRAMUNE_READ_WINDOW <= 16 && FRAMUNE_WRITE_WINDOW <= 16,
+              "The frame windows can't be more than 16 frames");
+static_assert(FRAMUNE_FRAME_SLOTS >= 2,
+              "The scratch buffer needs room for two frames being written");
+
+// Templated on the memory chip type so that the per-byte calls into a
+// compile-time specialized BasicMemoryChip get inlined too.
+template <class MemoryChipType>
+class BasicSerialInterface
 {
 public:
-    SerialInterface(Stream* serial, MemoryChip* memoryChip);
+    // Without setBaudRate, the baud rate just can't be changed.
+    BasicSerialInterface(Stream* serial, MemoryChipType* memoryChip,
+                         SerialBaudRateFunction setBaudRate = NULL);
     bool update();
 private:
     void _turnMemoryOnTemporarily();
     void _returnMemoryPowerState();
     int _readByteWithTimeout(uint8_t& n);
+    int _readUint16WithTimeout(uint16_t& n);
     int _readUint32WithTimeout(uint32_t& n);
     void _writeUint16(uint16_t n);
     void _writeUint32(uint32_t n);
@@ -29,11 +92,69 @@ private:
         MemoryChipKnownProperties& knownProperties,
         MemoryChipProperties& properties
     );
-    int _readAddressAndSize(uint16_t& address, uint32_t& size);
+    int _readAddressAndSize(uint32_t& address, uint32_t& size);
     bool _commandRead();
     bool _stateReading();
-    bool _commandWrite();
+    void _endReading();
+    bool _commandWrite(bool isWritingChangesOnly);
     bool _stateWriting();
+    size_t _writeBytes(uint8_t* source, size_t length);
+    void _abortWriting();
+    void _commandGetAndResetStats();
+    void _commandRunMarchTest();
+    void _commandDiagnoseLines();
+    void _commandMeasureRetention();
+    void _commandFill();
+    void _commandGetBlockChecksums();
+    void _commandGetDigest();
+    uint32_t _readBackCrc32(uint32_t address, uint32_t size, bool& allBytesSeemPulled);
+    void _commandSetBaudRate();
+    bool _receiveBaudRateCheck();
+    void _revertBaudRateIfIdle();
+
+    enum class FrameMarker : uint8_t
+    {
+        CANCEL = 0xF9,
+        START,
+        ACK,
+        NAK,
+        END,
+        FIN
+    };
+
+    // What the host asks for after the address and size of a READ, WRITE or
+    // WRITE_CHANGED. The F-Ramune answers with what it'll actually use.
+    enum class FrameEncoding : uint8_t
+    {
+        RAW,
+        // See framecompression.hpp.
+        COMPRESSED
+    };
+
+    enum class FrameStatus
+    {
+        INTACT,
+        NONE,
+        // With the sequence number intact, so it can be NAKed.
+        DAMAGED,
+        UNNUMBERED
+    };
+
+    void _beginFrames(uint32_t address, uint32_t size, uint8_t window);
+    void _frameRange(uint32_t index, uint32_t& start, uint32_t& end);
+    bool _frameIndex(uint8_t sequence, uint32_t& index);
+    void _markFrameDone(uint32_t index);
+    void _sendFrame(uint32_t index);
+    FrameStatus _receiveFrame(uint8_t* frame, uint8_t& sequence);
+    uint8_t _receiveFrameBytes(uint8_t* dest, uint8_t length,
+                               unsigned long int startedAt);
+    bool _takeInFrames();
+    int8_t _freeFrameSlot();
+    void _sendControl(FrameMarker marker, uint8_t sequence);
+    bool _isControl(int n);
+    bool _receiveControl(FrameMarker& marker, uint8_t& sequence);
+    void _finishFrames();
+    void _discardInput();
 
     enum class SerialState
     {
@@ -47,19 +168,69 @@ private:
         GET_VERSION,
         SET_AND_ANALYZE_CHIP,
         READ,
-        WRITE
+        WRITE,
+        GET_AND_RESET_STATS,
+        RUN_MARCH_TEST,
+        DIAGNOSE_LINES,
+        GET_ADDRESS_WIDTH,
+        MEASURE_RETENTION,
+        WRITE_CHANGED,
+        FILL,
+        GET_BLOCK_CHECKSUMS,
+        GET_DIGEST,
+        SET_BAUD_RATE
     };
 
     Stream* _serial;
-    MemoryChip* _memoryChip;
-    SerialState _state;
+    MemoryChipType* _memoryChip;
+    SerialBaudRateFunction _setBaudRate;
+    uint32_t _baudRate = FRAMUNE_DEFAULT_BAUD_RATE;
+    // When the last command finished, for going back to the default baud
+    // rate when the host's gone quiet.
+    unsigned long int _lastCommandMillis = 0;
+    SerialState _state = SerialState::WAITING_FOR_COMMAND;
 
     bool _prevMemoryPowerState;
-    uint16_t _currentOperationStart;
+    uint32_t _currentOperationStart;
     uint32_t _currentOperationSize;
-    uint16_t _currentAddress;
-    uint32_t _currentBytesLeft;
+    uint32_t _currentAddress;
     CRC32 _currentCrc32;
+    // Frames, for reads and writes, numbered from the transfer's first.
+    // The ones from _frameBase on are still on their way, and the masks
+    // are relative to it - bit 0 is _frameBase itself. For reads,
+    // _frameNext is the next one that's never been sent.
+    uint32_t _frameBase;
+    uint32_t _frameNext;
+    uint32_t _frameCount;
+    uint8_t _frameWindow;
+    bool _isCompressingFrames;
+    // Acknowledged, for reads, and in a slot (or already written), for
+    // writes.
+    uint16_t _framesDone;
+    uint16_t _framesToResend;
+    // When the host last got anywhere, and how many timeouts since then.
+    unsigned long int _frameProgressMillis;
+    uint8_t _frameTimeouts;
+    // For WRITE_CHANGED, which leaves bytes that are already right alone,
+    // and tells how many it changed at the end.
+    bool _isWritingChangesOnly;
+    uint32_t _currentBytesChanged;
+    // The scratch buffer, while a read or write's borrowing it - for a
+    // compressed read, the frame before and after compressing it, and for a
+    // write, cut up into frame slots. Which ones have a frame waiting to be
+    // written, and which.
+    uint8_t* _frameBuffer = NULL;
+    uint8_t _frameSlotsUsed;
+    uint32_t _frameSlotIndices[FRAMUNE_FRAME_SLOTS];
+    // When the current read or write started, for STATS.
+    unsigned long int _currentOperationStartedAt;
 };
 
+typedef BasicSerialInterface<MemoryChip> SerialInterface;
+
+// Same deal as in channelio.hpp.
+#define INCLUDING_SERIALINTERFACE_TEMPLATES
+#include "serialinterface.cpp"
+#undef INCLUDING_SERIALINTERFACE_TEMPLATES
+
 #endif
@@ -1,6 +1,8 @@
 #include <Bounce2.h>
+#include "bufferedserial.hpp"
 #include "channelio.hpp"
 #include "memorychip.hpp"
+#include "scratch.hpp"
 #include "serialinterface.hpp"
 
 // If you want to use an MCU or pinout other than the ones found in the
@@ -13,6 +15,9 @@
 #define PIN_MEMORY_CE    A4
 #define PIN_MEMORY_OE    A5
 #define PIN_MEMORY_WE    2
+typedef MemoryChipStaticPins<
+    PIN_MEMORY_CE, PIN_MEMORY_OE, PIN_MEMORY_WE, PIN_MEMORY_POWER
+> ControlPins;
 
 // Memory chip address channel
 // Latch pin: 10 (SS - doesn't need to be SS, but might as well be)
@@ -20,23 +25,21 @@
 // to be an input (but the pull-up is still available), and SS has to
 // stay configured as an output to stay master!
 // Within those config constraints, though, they can be used for unrelated IO.
-Output_SpiShiftRegister<uint16_t> ADDRESS_CHANNEL(20000000, SPI_MODE0, 10);
+// (Output_UsartSpiShiftRegister is faster, but can't be used with this
+// pinout - see the hardware README.)
+// For chips over 64 KiB, add a third 74HC595 to the chain and make this
+// uint24_t instead of uint16_t - the memory chip's addresses follow along.
+typedef Output_SpiShiftRegister<uint16_t, StaticPin<10>> AddressChannel;
+AddressChannel ADDRESS_CHANNEL(20000000, SPI_MODE0, StaticPin<10>());
 
 // Memory chip data channel
 // Note that INPUT_PULLUP here is important - otherwise, reading when there's
 // no chip connected will read back what was just written (ghooost values).
-// 5 bits starting at bit #3, via port D
-InputOutput_Port DATA_CHANNEL_PORT_1(INPUT_PULLUP, &PIND, &PORTD, &DDRD, 3, 3, 5);
-// 3 bits starting at bit #0, via port C
-InputOutput_Port DATA_CHANNEL_PORT_2(INPUT_PULLUP, &PINC, &PORTC, &DDRC, 0, 0, 3);
-InputOutput_Port* DATA_CHANNEL_PORTS[] = {
-    &DATA_CHANNEL_PORT_1,
-    &DATA_CHANNEL_PORT_2
-};
-InputOutputChannelSet<uint8_t, InputOutput_Port> DATA_CHANNEL(
-    sizeof(DATA_CHANNEL_PORTS) / sizeof(*DATA_CHANNEL_PORTS),
-    DATA_CHANNEL_PORTS
-);
+// Data bits 0-2 on A0-A2 (port C bits 0-2), and 3-7 on D3-D7 (port D bits
+// 3-7). Since the bits line up with their ports' bits, this compiles to one
+// masked access per port. Any other order of pins works too, though!
+typedef InputOutput_PinBus<A0, A1, A2, 3, 4, 5, 6, 7> DataChannel;
+DataChannel DATA_CHANNEL(INPUT_PULLUP);
 
 // Buttons 'n' lights
 #define PIN_TEST_BUTTON 12
@@ -49,13 +52,61 @@ InputOutputChannelSet<uint8_t, InputOutput_Port> DATA_CHANNEL(
 
 #endif
 
-MemoryChip MEMORY_CHIP(&ADDRESS_CHANNEL, &DATA_CHANNEL,
-                       PIN_MEMORY_CE, PIN_MEMORY_OE, PIN_MEMORY_WE,
-                       PIN_MEMORY_POWER, PIN_MEMORY_POWER_ON_STATE);
-SerialInterface SERIAL_INTERFACE(&Serial, &MEMORY_CHIP);
+// AddressChannel and DataChannel should be the channels' concrete types, so
+// that the memory chip's per-byte path compiles down to direct port access.
+// If that's not possible for your setup (say, if the channels are picked at
+// runtime), typedef them to OutputChannel<uint16_t> and
+// InputOutputChannel<uint8_t> - that works too, just a bit slower.
+// The same goes for ControlPins: on an MCU StaticPin doesn't know, typedef it
+// to MemoryChipRuntimePins and construct it with the pin numbers.
+typedef BasicMemoryChip<AddressChannel, DataChannel, ControlPins>
+    LayoutMemoryChip;
+LayoutMemoryChip MEMORY_CHIP(&ADDRESS_CHANNEL, &DATA_CHANNEL, ControlPins(),
+                             PIN_MEMORY_POWER_ON_STATE);
+
+// UART (from bufferedserial.hpp) instead of Serial, so that the host can
+// switch to a faster baud rate - see SET_BAUD_RATE in serialinterface.hpp.
+// To go back to Serial, delete bufferedserial.cpp (its interrupt handlers
+// clash with HardwareSerial's), use Serial and Serial.begin(115200) in
+// place of UART, and pass NULL instead of setUartBaudRate (deleting it
+// too) - the host then stays at 115200. Serial's receive buffer has to
+// fit a write window's worth of frames too (see below), so raise
+// SERIAL_RX_BUFFER_SIZE to match.
+bool setUartBaudRate(uint32_t baudRate, bool isSwitching)
+{
+    if (baudRate != FRAMUNE_DEFAULT_BAUD_RATE &&
+        !BufferedUart::isBaudRateExact(baudRate)) {
+        return false;
+    }
+    if (isSwitching) {
+        UART.begin(baudRate);
+    }
+    return true;
+}
+// However fast the host sends frames to be written, UART's receive buffer
+// can't overflow, as long as a window's worth of them fits in it - the
+// host has to wait for ACKs after that.
+static_assert(FRAMUNE_WRITE_WINDOW * FRAMUNE_MAX_FRAME_LENGTH <=
+              BUFFERED_UART_RX_BUFFER_SIZE,
+              "FRAMUNE_WRITE_WINDOW's too big for UART's receive buffer");
+BasicSerialInterface<LayoutMemoryChip> SERIAL_INTERFACE(&UART, &MEMORY_CHIP,
+                                                        setUartBaudRate);
 
 Bounce TEST_BUTTON = Bounce();
 
+void blinkWhileTesting()
+{
+    static unsigned long int prevBlinkMillis = 0;
+    static uint8_t blinkState = HIGH;
+    unsigned long int curMillis = millis();
+    if (curMillis - prevBlinkMillis >= 333) {
+        blinkState = !blinkState;
+        digitalWrite(PIN_HAPPY_LED, blinkState);
+        digitalWrite(PIN_FROWNY_LED, !blinkState);
+        prevBlinkMillis = curMillis;
+    }
+}
+
 void testChip()
 {
     MemoryChipKnownProperties prevKnownProperties;
@@ -92,27 +143,14 @@ void testChip()
     } else {
         // And for posterity, we test that all memory cells work, too.
         // Since testing *all* addresses takes some time, this requires
-        // a little "working..." animation.
-        uint8_t blinkState = HIGH;
+        // a little "working..." animation. To pick a more (or less) thorough
+        // test, see MARCH_TEST_DEFAULT_ALGORITHM in marchtest.hpp.
         digitalWrite(PIN_HAPPY_LED, HIGH);
-        unsigned long int prevBlinkMillis = millis();
-        bool allAddressesWork = true;
-        for (uint32_t windowStart = 0; windowStart < properties.size; windowStart += 512) {
-            uint32_t windowEnd = windowStart + 512;
-            windowEnd = windowEnd <= properties.size ? windowEnd : properties.size;
-            if (!MEMORY_CHIP.addressesWorkBetween(windowStart, windowEnd)) {
-                allAddressesWork = false;
-                break;
-            }
-
-            unsigned long int curMillis = millis();
-            if (curMillis - prevBlinkMillis >= 333) {
-                blinkState = !blinkState;
-                digitalWrite(PIN_HAPPY_LED, blinkState);
-                digitalWrite(PIN_FROWNY_LED, !blinkState);
-                prevBlinkMillis = curMillis;
-            }
-        }
+        MarchAlgorithm algorithm;
+        getMarchAlgorithm(MARCH_TEST_DEFAULT_ALGORITHM, &algorithm);
+        bool allAddressesWork = MEMORY_CHIP.runMarchTest(
+            algorithm, 0, properties.size, NULL, blinkWhileTesting
+        );
 
         digitalWrite(PIN_HAPPY_LED, LOW);
         digitalWrite(PIN_FROWNY_LED, LOW);
@@ -136,7 +174,9 @@ void testChip()
 
 void setup()
 {
-    Serial.begin(115200);
+    // As early as possible, so the stats' stack use includes all of setup.
+    paintUnusedStack();
+    UART.begin(FRAMUNE_DEFAULT_BAUD_RATE);
     MEMORY_CHIP.initPins();
     TEST_BUTTON.attach(PIN_TEST_BUTTON, INPUT_PULLUP);
     TEST_BUTTON.interval(25);
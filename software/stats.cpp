@@ -0,0 +1,17 @@
+#include "stats.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include "scratch.hpp"
+
+#if STATS_ENABLED
+uint32_t STATS[STATS_NUM_COUNTERS];
+#endif
+
+void resetStats()
+{
+#if STATS_ENABLED
+    memset(STATS, 0, sizeof(STATS));
+    paintUnusedStack();
+#endif
+}
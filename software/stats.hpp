@@ -0,0 +1,75 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// Performance counters, for seeing where the time actually goes on a real
+// device. framune.py's "stats" command gets (and resets) them. They cost
+// 4 bytes of RAM each and a few cycles here and there - define STATS_ENABLED
+// as 0 to compile them out entirely.
+#ifndef STATS_ENABLED
+#define STATS_ENABLED 1
+#endif
+
+// These are sent in this order, so only ever add new ones right before
+// STATS_NUM_COUNTERS - and add them to STATS_COUNTERS in framune.py too.
+enum StatsCounter : uint8_t
+{
+    STATS_BYTES_READ,
+    STATS_BYTES_WRITTEN,
+    STATS_MODE_SWITCHES,
+    STATS_POWER_CYCLES,
+    STATS_SERIAL_TIMEOUTS,
+    // The rest are in µs. Note that micros() only has a resolution of 4 µs.
+    // Analyzing the chip.
+    STATS_MICROS_ANALYZING,
+    // All of a read, from the command coming in to the CRC going out.
+    STATS_MICROS_READING,
+    // All of a write apart from verifying it afterwards, waiting for the
+    // data to come in included. Minus STATS_MICROS_RECEIVING, that's the
+    // time spent actually writing.
+    STATS_MICROS_WRITING,
+    // Waiting for bytes to come in over serial (in writes and elsewhere).
+    STATS_MICROS_RECEIVING,
+    // The CRC re-read at the end of a write.
+    STATS_MICROS_VERIFYING,
+    // The extra write to check whether the data lines are just pulled.
+    STATS_MICROS_PULL_UP_CHECK,
+    // March tests, line diagnoses and retention curves run over serial.
+    STATS_MICROS_TESTING,
+    // Not a count, but a low-water mark: how many bytes of the stack were
+    // never used since the last reset (see scratch.hpp). Filled in when
+    // the stats are sent.
+    STATS_STACK_BYTES_NEVER_USED,
+    // Bytes the serial port dropped or lost: framing errors, overruns, and
+    // bytes that didn't fit in the receive buffer. (Only counted by
+    // BufferedUart - see bufferedserial.hpp.)
+    STATS_SERIAL_ERRORS,
+    // A high-water mark: the most bytes BufferedUart's receive buffer has
+    // held at once. If it's close to BUFFERED_UART_RX_BUFFER_SIZE, the
+    // buffer's too small for the baud rate.
+    STATS_SERIAL_RX_BUFFER_PEAK,
+    // Frames of reads and writes that got lost or damaged on the way, and
+    // had to be sent again.
+    STATS_FRAMES_RESENT,
+    STATS_NUM_COUNTERS
+};
+
+extern uint32_t STATS[STATS_NUM_COUNTERS];
+
+#if STATS_ENABLED
+#define STATS_ADD(counter, n) (STATS[counter] += (n))
+#define STATS_TIMESTAMP() micros()
+#else
+// sizeof, so that whatever n is still counts as used, but is never computed.
+#define STATS_ADD(counter, n) ((void) sizeof(n))
+#define STATS_TIMESTAMP() 0UL
+#endif
+#define STATS_COUNT(counter) STATS_ADD(counter, 1)
+#define STATS_ADD_TIME_SINCE(counter, timestamp) \
+    STATS_ADD(counter, micros() - (timestamp))
+
+void resetStats();
+
+#endif